@@ -24,25 +24,57 @@ OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWA
 #include <assert.h>
 #include <math.h>
 #include <stdint.h>
+#include <limits.h>
+#include <string.h>
 #include <vector>
+#include <algorithm>
 #include <unordered_set>
 #include <unordered_map>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #define __STDC_FORMAT_MACROS
 #include "time_mem.h"
 
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef USE_LZMA
+#include <lzma.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define HAVE_MMAP
+#define HAVE_FORK
+#endif
+
 #define TIMEOUT     20000
 #define BIGINIT     1000000
 #define INIT        10
+#define READBUF     (1 << 22)	// size of the read buffer for stdin and pipes
+#define WRITEBUF    (1 << 22)	// size of the buffer of each output file
 #define END         0
+#define WATCH       2		// longs per watch: clause offset with mask bit and blocking literal
 #define UNSAT       0
 #define SAT         1
 #define ID         -1
 #define PIVOT      -2
-#define MAXDEP	   -3
-#define CLID       -5
-#define CONFLICT_NO  -7
-#define ANC_DATA_AT -9
-#define EXTRA       10		// ID + PIVOT + MAXDEP + CLID + CLID_ANC + stuff + terminating 0
+#define REMOVED    -3		// non-zero while the watches of the clause are stale: 1 + sweeps at removal
+#define IDHIGH     -4		// only in wide clauses: the bits of the ID above IDBITS
+#define EXTRA       4		// ID + PIVOT + REMOVED + terminating 0
+#ifndef IDBITS
+#define IDBITS     30		// clause IDs are stored shifted left by one in ints
+#endif
+#define MAXID       ((1 << IDBITS) - 1)
+#define WIDEMARK    INT_MIN	// in S->lratTable: the high and low half of a long follow
 #define INFOBITS    2		// could be 1 for SAT, must be 2 for QBF
 #define DBIT        1
 #define ASSUMED     2
@@ -58,6 +90,8 @@ OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWA
 #define FIXPOINT	 60
 #define NOWARNING	 70
 #define HARDWARNING	 80
+#define RATSPLIT	 64		// RAT checks with fewer candidates stay on one thread
+#define SKIPPED		 90
 
 #define COMPRESS
 
@@ -127,13 +161,390 @@ namespace std
     };
 }
 
-struct solver { FILE *inputFile, *proofFile, *lratFile, *traceFile, *activeFile;
-    int *DB, nVars, timeout, mask, deleted, *falseStack, *falsified, *forced, binMode, binOutput,
-      *processed, *assigned, count, *used, *max, COREcount, RATmode, RATcount, nActive, *lratTable,
-      nLemmas, maxRAT, *RATset, *preRAT, maxDependencies, nDependencies, bar, backforce, reduce,
-      *dependencies, maxVar, maxSize, mode, verb, unitSize, prep, *current, nRemoved, warning,
-      delProof, *setMap, *setTruth;
+// Lock-free single-producer single-consumer ring of RING pointers, used to pass
+// filled buffers from a helper thread to the main thread and back for reuse
+#define RING        64
+
+struct ring { void *slot[RING]; std::atomic<long> head, tail; };
+
+static int ringTryPush (struct ring *Q, void *item) {
+  long tail = Q->tail.load (std::memory_order_relaxed);
+  if (tail - Q->head.load (std::memory_order_acquire) == RING) return 0;
+  Q->slot[tail % RING] = item;
+  Q->tail.store (tail + 1, std::memory_order_release);
+  return 1; }
+
+static void *ringTryPop (struct ring *Q) {
+  long head = Q->head.load (std::memory_order_relaxed);
+  if (Q->tail.load (std::memory_order_acquire) == head) return NULL;
+  void *item = Q->slot[head % RING];
+  Q->head.store (head + 1, std::memory_order_release);
+  return item; }
+
+// Compressed inputs are recognized by their magic bytes and decompressed on a separate
+// thread, which hands the output to the reader in blocks of BLOCK bytes
+#define GZIP        1
+#define XZ          2
+#define ZSTD        3
+#define BLOCK       (1 << 20)
+#if defined (USE_ZLIB) || defined (USE_LZMA) || defined (USE_ZSTD)
+#define HAVE_DECODER
+#endif
+
+// The last block of the output has last set: to 1 at the end of the input, to 2 if
+// data after the final gzip member was ignored, and to -1 if decoding failed.  The
+// reader reports the latter two once it gets there, on its own thread
+struct block { long used; int last; };	// followed by BLOCK bytes of data
+struct decoder { FILE *file; int format; std::atomic<int> stop; struct ring full, unused;
+                 struct block *current; std::thread thread;
+                 unsigned char head[6]; long headSize; };	// read ahead from a pipe
+
+static inline unsigned char *blockData (struct block *b) { return (unsigned char*) (b + 1); }
+
+static int compressionFormat (unsigned char *magic, long n) {
+  if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) return GZIP;
+  if (n == 6 && !memcmp (magic, "\xfd" "7zXZ", 6)) return XZ;
+  if (n >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) return ZSTD;
+  return 0; }
+
+#ifdef HAVE_DECODER
+static struct block *newBlock (struct decoder *D) {
+  struct block *b = (struct block*) ringTryPop (&D->unused);
+  if (b == NULL) b = (struct block*) malloc (sizeof (struct block) + BLOCK);
+  if (b == NULL) { printf ("c MEMOUT: allocation of decompression block failed\n"); exit (0); }
+  b->used = 0; b->last = 0;
+  return b; }
+
+static void pushBlock (struct decoder *D, struct block *b) {
+  while (!ringTryPush (&D->full, b)) {
+    if (D->stop) { free (b); return; }
+    std::this_thread::yield (); } }
+
+// Runs on the decoder thread.  Reads the compressed file in chunks of BLOCK bytes and
+// passes full output blocks to the reader until the end of the input or D->stop
+static void decodeInput (struct decoder *D) {
+  unsigned char *in = (unsigned char*) malloc (BLOCK), *next = in;
+  if (in == NULL) { printf ("c MEMOUT: allocation of decompression buffer failed\n"); exit (0); }
+  long avail = D->headSize;
+  memcpy (in, D->head, avail);
+  int eof = 0, end = 0, clean = 1, member = 0, trailing = 0;
+  struct block *out = newBlock (D);
+#ifdef USE_ZLIB
+  z_stream zs; memset (&zs, 0, sizeof (zs));
+  if (D->format == GZIP && inflateInit2 (&zs, 15 + 32) != Z_OK) end = ERROR;
+#endif
+#ifdef USE_LZMA
+  lzma_stream xs = LZMA_STREAM_INIT;
+  if (D->format == XZ && lzma_stream_decoder (&xs, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) end = ERROR;
+#endif
+#ifdef USE_ZSTD
+  ZSTD_DStream *zd = NULL;
+  if (D->format == ZSTD && ((zd = ZSTD_createDStream ()) == NULL || ZSTD_isError (ZSTD_initDStream (zd)))) end = ERROR;
+#endif
+  while (!end && !D->stop) {
+    if (avail == 0 && !eof) {
+      avail = fread (in, 1, BLOCK, D->file); next = in;
+      if (avail == 0) eof = 1; }
+    unsigned char *dst = blockData (out) + out->used;
+    long room = BLOCK - out->used, produced = 0;
+    switch (D->format) {
+#ifdef USE_ZLIB
+      case GZIP: {
+        if (member && avail && (next[0] != 0x1f || (avail > 1 && next[1] != 0x8b))) {
+          end = SUCCESS; trailing = 1; break; } // not another member: ignored, as gzip does
+        member = 0;
+        zs.next_in = next; zs.avail_in = avail; zs.next_out = dst; zs.avail_out = room;
+        int ret = inflate (&zs, Z_NO_FLUSH);
+        produced = room - zs.avail_out;
+        if (zs.next_in != next) clean = 0;
+        next = zs.next_in; avail = zs.avail_in;
+        if (ret == Z_STREAM_END) { clean = 1; member = 1; inflateReset (&zs); } // concatenated members
+        else if (ret != Z_OK && ret != Z_BUF_ERROR) end = ERROR;
+        break; }
+#endif
+#ifdef USE_LZMA
+      case XZ: {
+        xs.next_in = next; xs.avail_in = avail; xs.next_out = dst; xs.avail_out = room;
+        lzma_ret ret = lzma_code (&xs, eof ? LZMA_FINISH : LZMA_RUN);
+        produced = room - xs.avail_out;
+        next = (unsigned char*) xs.next_in; avail = xs.avail_in;
+        if (ret == LZMA_STREAM_END) end = SUCCESS;
+        else if (ret != LZMA_OK) end = ERROR;
+        break; }
+#endif
+#ifdef USE_ZSTD
+      case ZSTD: {
+        ZSTD_inBuffer  zin  = { next, (size_t) avail, 0 };
+        ZSTD_outBuffer zout = { dst,  (size_t) room,  0 };
+        size_t ret = ZSTD_decompressStream (zd, &zout, &zin);
+        produced = zout.pos;
+        next += zin.pos; avail -= zin.pos;
+        if (ZSTD_isError (ret)) end = ERROR;
+        else clean = ret == 0;
+        break; }
+#endif
+      default: end = ERROR; }
+    out->used += produced;
+    if (out->used == BLOCK) { pushBlock (D, out); out = newBlock (D); }
+    else if (!end && eof && avail == 0 && D->format != XZ) end = clean ? SUCCESS : ERROR; }
+
+#ifdef USE_ZLIB
+  if (D->format == GZIP) inflateEnd (&zs);
+#endif
+#ifdef USE_LZMA
+  if (D->format == XZ) lzma_end (&xs);
+#endif
+#ifdef USE_ZSTD
+  if (D->format == ZSTD) ZSTD_freeDStream (zd);
+#endif
+  free (in);
+  out->last = end == ERROR ? -1 : trailing ? 2 : 1;
+  pushBlock (D, out); }
+#endif
+
+static struct decoder *startDecoder (FILE *file, int format, unsigned char *head, long headSize) {
+  const char *name[] = { "", "gzip", "xz", "zstd" };
+  int supported = 0;
+#ifdef USE_ZLIB
+  supported |= format == GZIP;
+#endif
+#ifdef USE_LZMA
+  supported |= format == XZ;
+#endif
+#ifdef USE_ZSTD
+  supported |= format == ZSTD;
+#endif
+  if (!supported) {
+    printf ("c ERROR: this drat-trim was built without %s support\n", name[format]); exit (0); }
+  struct decoder *D = new decoder;
+  D->file = file; D->format = format; D->stop = 0; D->current = NULL;
+  memcpy (D->head, head, headSize); D->headSize = headSize;
+  D->full.head = D->full.tail = D->unused.head = D->unused.tail = 0;
+#ifdef HAVE_DECODER
+  D->thread = std::thread (decodeInput, D);
+#endif
+  return D; }
+
+static void stopDecoder (struct decoder *D) {
+  void *b;
+  D->stop = 1;
+  D->thread.join ();
+  while ((b = ringTryPop (&D->full))   != NULL) free (b);
+  while ((b = ringTryPop (&D->unused)) != NULL) free (b);
+  free (D->current);
+  delete D; }
+
+// Input is tokenized straight out of a memory mapping of the file; stdin, pipes and
+// other unmappable inputs are read through a large buffer that is refilled on demand,
+// and compressed inputs through the blocks of a decoder
+struct reader { FILE *file; unsigned char *buf, *pos, *end; long size, nBytes; int mapped;
+                struct decoder *decoder; };
+
+static void openReader (struct reader *R, FILE *file) {
+  R->file = file; R->buf = R->pos = R->end = NULL; R->size = R->nBytes = 0; R->mapped = 0;
+  R->decoder = NULL;
+  // The magic bytes are read ahead.  A pipe cannot seek back over them, so there they
+  // are kept in front of the rest of the input, in the decoder or in the read buffer
+  unsigned char magic[6];
+  long at = ftell (file), n = fread (magic, 1, 6, file);
+  int format = compressionFormat (magic, n);
+  if (at >= 0 && fseek (file, at, SEEK_SET) == 0) n = 0;
+  if (format) { R->decoder = startDecoder (file, format, magic, n); return; }
+#ifdef HAVE_MMAP
+  struct stat st;
+  if (fstat (fileno (file), &st) == 0 && S_ISREG (st.st_mode) && st.st_size > 0 && at == 0) {
+    void *map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno (file), 0);
+    if (map != MAP_FAILED) {
+      madvise (map, st.st_size, MADV_SEQUENTIAL);
+      R->buf = R->pos = (unsigned char*) map; R->end = R->buf + st.st_size;
+      R->size = st.st_size; R->mapped = 1; return; } }
+#endif
+  R->size = READBUF;
+  R->buf  = R->pos = R->end = (unsigned char*) malloc (R->size);
+  if (R->buf == NULL) { printf ("c MEMOUT: allocation of read buffer failed\n"); exit (0); }
+  memcpy (R->buf, magic, n); R->end += n; }
+
+static void closeReader (struct reader *R) {
+  R->nBytes += R->pos - R->buf;
+  if (R->decoder) { stopDecoder (R->decoder); R->decoder = NULL; R->buf = R->pos = R->end = NULL; return; }
+#ifdef HAVE_MMAP
+  if (R->mapped) munmap (R->buf, R->size); else
+#endif
+  free (R->buf);
+  R->buf = R->pos = R->end = NULL; }
+
+static int refill (struct reader *R) {
+  struct decoder *D = R->decoder;
+  if (D) {
+    R->nBytes += R->pos - R->buf;
+    if (D->current && D->current->last) {
+      if (D->current->last < 0) { printf ("c ERROR: corrupted or truncated compressed input\n"); exit (0); }
+      if (D->current->last == 2) printf ("c WARNING: ignoring trailing data after the compressed input\n");
+      D->current->last = 1;
+      R->buf = R->pos; return 0; }
+    if (D->current && !ringTryPush (&D->unused, D->current)) free (D->current);
+    while ((D->current = (struct block*) ringTryPop (&D->full)) == NULL) std::this_thread::yield ();
+    R->buf = R->pos = blockData (D->current); R->end = R->buf + D->current->used;
+    return R->pos < R->end || refill (R); }
+  if (R->mapped || R->buf == NULL) return 0;
+  R->nBytes += R->pos - R->buf;
+  long n = fread (R->buf, 1, R->size, R->file);
+  R->pos = R->buf; R->end = R->buf + (n > 0 ? n : 0);
+  return n > 0; }
+
+static inline long readerBytes (struct reader *R) { // bytes consumed so far
+  return R->nBytes + (R->pos - R->buf); }
+
+static inline int peekChar (struct reader *R) {
+  if (R->pos == R->end && !refill (R)) return EOF;
+  return *R->pos; }
+
+static inline int getChar (struct reader *R) {
+  if (R->pos == R->end && !refill (R)) return EOF;
+  return *R->pos++; }
+
+static inline int skipSpace (struct reader *R) {
+  int c;
+  while ((c = peekChar (R)) == ' ' || c == '\n' || c == '\t' || c == '\r') R->pos++;
+  return c; }
+
+static void skipLine (struct reader *R) {
+  int c;
+  do { c = getChar (R); } while (c != '\n' && c != EOF); }
+
+// Reads a decimal number with optional sign, surrounded by white space. Returns 1 on
+// success, 0 if the next token is not a number, and EOF at the end of the input
+static int readNumber (struct reader *R, long *number) {
+  int c = skipSpace (R), sign = 1;
+  if (c == EOF) return EOF;
+  if (c == '-') { sign = -1; R->pos++; c = peekChar (R); }
+  if (c < '0' || c > '9') return 0;
+  long n = 0;
+  while ((c = peekChar (R)) >= '0' && c <= '9') { n = n * 10 + (c - '0'); R->pos++; }
+  *number = sign * n;
+  skipSpace (R);
+  return 1; }
+
+static inline int readLiteral (struct reader *R, int *lit) {
+  long n = 0; int res = readNumber (R, &n);
+  *lit = (int) n;
+  return res; }
+
+// The output files are written through a buffer of their own, with the numbers
+// formatted by hand instead of by fprintf.  written counts the bytes flushed so far.
+// A closed writer keeps its place in the solver but drops what is written to it
+struct writer { FILE *file; char *buffer; long used, written; };
+
+static struct writer *openWriter (FILE *file) {
+  if (file == NULL) return NULL;
+  struct writer *W = (struct writer *) malloc (sizeof (struct writer));
+  if (W) W->buffer = (char *) malloc (WRITEBUF);
+  if (W == NULL || W->buffer == NULL) { printf ("c MEMOUT: allocation of output buffer failed\n"); exit (0); }
+  W->file = file; W->used = W->written = 0;
+  return W; }
+
+static void flushWriter (struct writer *W) {
+  if (W->file && W->used) fwrite (W->buffer, 1, W->used, W->file);
+  W->written += W->used; W->used = 0; }
+
+static void closeWriter (struct writer *W) {
+  if (W == NULL) return;
+  flushWriter (W);
+  if (W->file) fclose (W->file);
+  W->file = NULL; }
+
+static void freeWriter (struct writer *W) {
+  if (W == NULL) return;
+  closeWriter (W);
+  free (W->buffer); free (W); }
+
+static inline void writeChar (struct writer *W, char c) {
+  if (W->used == WRITEBUF) flushWriter (W);
+  W->buffer[W->used++] = c; }
+
+static inline void writeString (struct writer *W, const char *str) {
+  while (*str) writeChar (W, *str++); }
+
+static void writeBytes (struct writer *W, const void *data, long bytes) {
+  const char *from = (const char *) data;
+  while (bytes > 0) {
+    if (W->used == WRITEBUF) flushWriter (W);
+    long n = std::min (bytes, WRITEBUF - W->used);
+    memcpy (W->buffer + W->used, from, n);
+    W->used += n; from += n; bytes -= n; } }
+
+// Writes n in decimal, followed by after unless that is 0
+static inline void writeNumber (struct writer *W, long n, char after) {
+  char digits[20];
+  int k = 0;
+  if (W->used + 24 > WRITEBUF) flushWriter (W);
+  char *out = W->buffer + W->used;
+  unsigned long u = n;
+  if (n < 0) { *out++ = '-'; u = -u; }
+  do { digits[k++] = '0' + u % 10; u /= 10; } while (u);
+  while (k) *out++ = digits[--k];
+  if (after) *out++ = after;
+  W->used = out - W->buffer; }
+
+// Writes u in the variable-length encoding of binary DRAT, seven bits per byte
+static inline void writeVarint (struct writer *W, unsigned long u) {
+  if (W->used + 10 > WRITEBUF) flushWriter (W);
+  char *out = W->buffer + W->used;
+  for (; u > 127; u >>= 7) *out++ = (char) (128 + (u & 127));
+  *out++ = (char) u;
+  W->used = out - W->buffer; }
+
+// Writes lit as binary DRAT does, 2 * var + sign, or in text followed by a space
+static inline void writeLiteral (struct writer *W, long lit, int binary) {
+  if (binary) writeVarint (W, ((unsigned long) labs (lit) << 1) + (lit < 0));
+  else        writeNumber (W, lit, ' '); }
+
+// The watch lists of all literals live in one arena of longs.  Each list has a header
+// with its start in the arena, its used size and its capacity, and the used part is
+// followed by END.  A full list grows in place when it is the topmost list, and moves
+// to the top otherwise; the holes left behind are reclaimed by compacting the arena.
+// Removing a clause only flags it, and stale counts the watches of removed clauses
+// that are still in the list
+struct watches { long start; int used, max, stale; };
+
+// Occurrence lists map a literal to the offsets of the watched clauses containing it.
+// They are only built when the first RAT check needs them
+struct occurs { long *list; int used, max; };
+
+// A solver that shares S->DB with other threads keeps what propagate () and the watch
+// lists write to a clause in a view by clause ID instead: the two watched literals,
+// which are otherwise kept in front of the clause, REMOVED and the ACTIVE flag
+struct view { int lits[2], removed, active; };
+
+// The core lemmas that shrinkDB () kept for printProof () lie at the end of S->DB, from
+// base on.  step is the first proof step of the part that has been cut
+struct keptLemmas { long step, base, released; int copy, literals; };
+
+// What a checker thread found out about one lemma in the parallel backward pass.  It
+// is kept until the lemma is committed in proof order (see backwardParallel)
+struct lemmaResult { std::atomic<int> status; int pivot, RATflag;
+                     vector<int> lits; vector<long> deps, marks; };
+
+struct solver { FILE *inputFile, *proofFile; struct writer *lratFile, *traceFile, *activeFile;
+    struct reader formulaReader, proofReader;
+    int *DB, nVars, timeout, mask, deleted, *falseStack, *forced, binMode, binOutput,
+      *processed, *assigned, COREcount, RATmode, RATcount, nActive, *lratTable,
+      nLemmas, maxRAT, maxDependencies, nDependencies, bar, backforce, reduce,
+      maxVar, maxSize, mode, verb, unitSize, prep, *current, nRemoved, warning,
+      delProof, *setMap, *setTruth, lemmaStamp;
     int cl_ids;
+    int8_t *falsified;             // per literal: 0, 1 if false, ASSUMED or MARK
+    long *RATset;                  // DB offsets of the resolution candidates
+    int pipeline, parseThreads, checkThreads, ratThreads, shards, shrink;
+    struct lemmaResult *result;    // set while a checker thread checks a lemma
+    struct view *view;             // set in the threads that share S->DB (see struct view)
+    int *scratch;                  // a lemma copied out of S->DB (see copyLemma)
+    struct ratPool *helpers;       // set once a RAT check is split (see splitRAT)
+    struct keptLemmas *kept;       // set with --shrink-db (see shrinkDB)
+    struct stream *stream;         // set with --stream (see streamProof)
+    vector<long> *markLog;         // clauses marked since the helpers were started
+    int *topLevel;                 // end of the top-level units on the trail during a RAT check
+    long backStep, ratSplits;      // proof step of the lemma that is checked in the backward pass
     char *coreStr, *lemmaStr, *usedClFname;
     long optimize;
     double start_time;
@@ -142,11 +553,26 @@ struct solver { FILE *inputFile, *proofFile, *lratFile, *traceFile, *activeFile;
     FILE* cl_used_file;
     FILE* anc_cl_used_file;
     long mem_used, time, nClauses, nStep, nOpt, nAlloc, *unitStack, *reason, lemmas, nResolve,
-         nReads, nWrites, lratSize, lratAlloc, *lratLookup, **wlist, *optproof, *formula, *proof;
+         nReads, nWrites, lratSize, lratAlloc, *lratLookup, *optproof, *formula, *proof;
+    long count, *dependencies, *preRAT; // clause IDs go beyond MAXID (see clauseID)
+    struct writer *lratSpill;      // LRAT dependencies on disk, indexed by lratLookup
+    const char *spillDir;
+    char *lratMap;                 // lratSpill mapped into memory while its lines are read back
+    long lratMapSize;
+    int compactLRAT;               // lratLookup indexes the bytes of compact lines (see compactLine)
+    unsigned char *lratBytes;
+    long lratBytesSize, lratBytesAlloc, lratInts;
+    struct watches *wlist, *blist;
+    struct occurs *occurs; int occursBuilt;
+    long *arena, arenaSize, arenaTop, arenaWaste, arenaPeak;
+    int sweeps;                    // times that all watch lists were emptied or swept
     long anc_assigned;
     long anc_anc_assigned;
     vector<unordered_set<AncData>> anc_datas; //NOTE: the 0th element is not used!
     unordered_map<HitData, float> hitdata;
+    int64_t *clid, *conflictNo, *ancAt; // cold clause data by clause ID, only with -i
+    long *maxDep;                  // largest dependency of each lemma, only with -O
+    long metaAlloc;
 
 };
 
@@ -156,10 +582,14 @@ static inline void assign (struct solver* S, int lit) {
 int compare (const void *a, const void *b) {
   return (*(int*)a - *(int*)b); }
 
+int longcompare (const void *a, const void *b) {
+  long x = *(long*)a, y = *(long*)b;
+  return (x > y) - (x < y); }
+
 int abscompare (const void *a, const void *b) {
   return (abs(*(int*)a) - abs(*(int*)b)); }
 
-// CONFLICT_NO, USED_NUM, LAST_USED, SUM_HIST_USED, CLID
+// Reads a 64-bit value stored as two ints by store_at ()
 int64_t get_at(int* lemma, int offset) {
     int64_t dat = 0;
     dat += lemma[offset]&0xffffffff;
@@ -172,13 +602,63 @@ void store_at(int* lemma, int64_t data) {
     *(lemma+1) = (data >> 32);
 }
 
+// A clause ID up to MAXID is stored in the ID field, shifted left by one for ACTIVE.
+// The clauses with larger IDs are wide: their header has the field IDHIGH in front,
+// which holds the bits above IDBITS, and the sign bit of their ID field is set
+static inline long fieldID (int* clause, int field) {
+  if (field >= 0) return field >> 1;
+  return ((long) clause[IDHIGH] << IDBITS) | ((field >> 1) & MAXID); }
+
+static inline long clauseID (int* clause) {
+  return fieldID (clause, clause[ID]); }
+
+// The ID of the clause shifted left by one, with the ACTIVE flag, as in S->time
+static inline long clauseTime (int* clause) {
+  return (clauseID (clause) << 1) | (clause[ID] & ACTIVE); }
+
+// The header of a fresh clause with ID id needs this many fields
+static inline int headerSize (long id) {
+  return id > MAXID ? EXTRA : EXTRA - 1; }
+
+static inline void setClauseID (int* clause, long id) {
+  if (id <= MAXID) { clause[ID] = id << 1; return; }
+  clause[ID] = INT_MIN | (int) ((id & MAXID) << 1);
+  clause[IDHIGH] = id >> IDBITS; }
+
+// The cold data of a clause is kept out of S->DB, in arrays indexed by the clause ID.
+// The clause IDs of -i and the ancestors are zero if the arrays were not allocated
+static inline int64_t getCLID (struct solver* S, int* clause) {
+  return S->clid ? S->clid[clauseID (clause)] : 0; }
+
+static inline int64_t getConflictNo (struct solver* S, int* clause) {
+  return S->conflictNo ? S->conflictNo[clauseID (clause)] : 0; }
+
+static inline int64_t getAncAt (struct solver* S, int* clause) {
+  return S->ancAt ? S->ancAt[clauseID (clause)] : 0; }
+
+// Makes room in the cold arrays for the clause IDs up to n; new entries are zero
+static void reserveMeta (struct solver* S, long n) {
+  if (n < S->metaAlloc || (!S->cl_ids && !S->optimize)) return;
+  long i, alloc = S->metaAlloc ? S->metaAlloc : INIT;
+  while (alloc <= n) alloc = (alloc * 3) >> 1;
+  if (S->cl_ids) {
+    S->clid       = (int64_t*) realloc (S->clid,       sizeof (int64_t) * alloc);
+    S->conflictNo = (int64_t*) realloc (S->conflictNo, sizeof (int64_t) * alloc);
+    S->ancAt      = (int64_t*) realloc (S->ancAt,      sizeof (int64_t) * alloc);
+    if (!S->clid || !S->conflictNo || !S->ancAt) { printf ("c MEMOUT: reallocation of clause IDs failed\n"); exit (0); }
+    for (i = S->metaAlloc; i < alloc; i++) S->clid[i] = S->conflictNo[i] = S->ancAt[i] = 0; }
+  if (S->optimize) {
+    S->maxDep = (long*) realloc (S->maxDep, sizeof (long) * alloc);
+    if (S->maxDep == NULL) { printf ("c MEMOUT: reallocation of dependency depths failed\n"); exit (0); }
+    for (i = S->metaAlloc; i < alloc; i++) S->maxDep[i] = 0; }
+  S->metaAlloc = alloc; }
+
 static inline void printClause (int* clause, solver* S) {
   //printf ("[%i] ", clause[ID]);
-  //printf ("[id %li] ", get_at(clause, CLID));
-  int64_t clause_id = get_at(clause, CLID);
-  int64_t anc_data_at = get_at(clause, ANC_DATA_AT);
+  int64_t clause_id = S ? getCLID (S, clause) : 0;
+  int64_t anc_data_at = S ? getAncAt (S, clause) : 0;
 
-  uint64_t conflict_no = get_at(clause, CONFLICT_NO);
+  uint64_t conflict_no = S ? getConflictNo (S, clause) : 0;
   printf("cl_id: %07ld", clause_id);
   printf(" conf: %07ld ", conflict_no);
   if (anc_data_at != 0 && S != NULL) {
@@ -195,29 +675,174 @@ static inline void printClause (int* clause, solver* S) {
   printf("\n");
 }
 
-static inline void addWatchPtr (struct solver* S, int lit, long watch) {
-  if (S->used[lit] + 1 == S->max[lit]) { S->max[lit] *= 1.5;
-    S->wlist[lit] = (long *) realloc (S->wlist[lit], sizeof (long) * S->max[lit]);
-//    if (S->max[lit] > 1000) printf("c watchlist %i increased to %i\n", lit, S->max[lit]);
-    if (S->wlist[lit] == NULL) { printf("c MEMOUT: reallocation failed for watch list of %i\n", lit); exit (0); } }
-  S->wlist[lit][ S->used[lit]++ ] = watch | S->mask;
-  S->wlist[lit][ S->used[lit]   ] = END; }
+// The two watched literals of clause, REMOVED and the ACTIVE flag, which are in the
+// clause itself unless S->DB is shared (see struct view)
+static inline int *watched (struct solver* S, int* clause) {
+  return S->view ? S->view[clauseID (clause)].lits : clause; }
+
+static inline int *removedField (struct solver* S, int* clause) {
+  return S->view ? &S->view[clauseID (clause)].removed : clause + REMOVED; }
+
+static inline int isActive (struct solver* S, int* clause) {
+  return S->view ? S->view[clauseID (clause)].active : clause[ID] & ACTIVE; }
+
+static inline void setActive (struct solver* S, int* clause) {
+  if (S->view) S->view[clauseID (clause)].active = 1;
+  else clause[ID] |= ACTIVE; }
+
+// A watch takes WATCH longs in the watch list of lit: the clause offset shifted left
+// by one with the core-first mask in the lowest bit, followed by a blocking literal of
+// the clause.  A true blocker shows that the clause is satisfied without reading it.
+// Binary clauses are kept apart in the implication lists blist, where the blocker is
+// the other literal, so that propagate() handles them before the longer clauses and
+// only reads the clause when it becomes a reason or a conflict
+static inline long *watchList (struct solver* S, struct watches *W) {
+  return S->arena + W->start; }
+
+static bool earlierWatches (const struct watches *a, const struct watches *b) {
+  return a->start < b->start; }
 
+// Slides all lists down over the holes in the arena, keeping their capacities
+static void compactArena (struct solver* S) {
+  vector<struct watches*> lists;
+  int i;
+  for (i = -S->maxVar; i <= S->maxVar; i++)
+    if (i) { lists.push_back (S->wlist + i); lists.push_back (S->blist + i); }
+  std::sort (lists.begin (), lists.end (), earlierWatches);
+  long top = 0;
+  for (struct watches *W : lists) {
+    if (W->start != top) memmove (S->arena + top, S->arena + W->start, sizeof (long) * (W->used + 1));
+    W->start = top; top += W->max; }
+  S->arenaTop = top; S->arenaWaste = 0; }
+
+// Increases the capacity of W by half.  Invalidates pointers into the arena
+static void growWatches (struct solver* S, struct watches *W) {
+  int max = W->max * 1.5;
+  if (W->start + W->max == S->arenaTop && W->start + max <= S->arenaSize) {
+    S->arenaTop += max - W->max; W->max = max; return; }
+  if (S->arenaTop + max > S->arenaSize) {
+    if (2 * S->arenaWaste > S->arenaTop) compactArena (S);
+    if (S->arenaTop + max > S->arenaSize) {
+      S->arenaSize = (S->arenaSize * 3) >> 1;
+      if (S->arenaSize < S->arenaTop + max) S->arenaSize = S->arenaTop + max;
+      S->arena = (long *) realloc (S->arena, sizeof (long) * S->arenaSize);
+//      printf("c watch arena increased to %li\n", S->arenaSize);
+      if (S->arena == NULL) { printf("c MEMOUT: reallocation of watch arena failed\n"); exit (0); }
+      if (S->arenaSize > S->arenaPeak) S->arenaPeak = S->arenaSize; } }
+  memcpy (S->arena + S->arenaTop, S->arena + W->start, sizeof (long) * (W->used + 1));
+  S->arenaWaste += W->max;
+  W->start = S->arenaTop; W->max = max; S->arenaTop += max; }
+
+static inline void pushWatch (struct solver* S, struct watches *W, long watch, int blocker) {
+  if (W->used + WATCH >= W->max) growWatches (S, W);
+  long *list = watchList (S, W);
+  list[ W->used++ ] = watch;
+  list[ W->used++ ] = blocker;
+  list[ W->used   ] = END; }
+
+static inline void addWatchPtr (struct solver* S, int lit, long watch, int blocker) {
+  pushWatch (S, S->wlist + lit, watch | S->mask, blocker); }
+
+// Clearing REMOVED would also revive the stale watches of the clause, if it had any.
+// A removed clause is only added again after all lists were emptied or swept since its
+// removal: by init () and by the sweepAllWatches () before the backward pass.  Binary
+// clauses leave no stale watches (see removeWatch)
 static inline void addWatch (struct solver* S, int* clause, int index) {
-  addWatchPtr (S, clause[index], ((long) (((clause) - S->DB)) << 1)); }
+  long watch = ((long) (((clause) - S->DB)) << 1) | S->mask;
+  int *lits = watched (S, clause), *removed = removedField (S, clause);
+  assert (*removed <= S->sweeps || !clause[2]);
+  *removed = 0;
+  pushWatch (S, (clause[2] ? S->wlist : S->blist) + lits[index], watch, lits[1 - index]); }
+
+// Drops the watches of removed clauses from W, keeping the order of the others, and
+// gives an unused tail back to the arena
+static void sweepWatches (struct solver* S, struct watches *W) {
+  long *list = watchList (S, W);
+  int i, j = 0;
+  for (i = 0; i < W->used; i += WATCH)
+    if (!*removedField (S, S->DB + (list[i] >> 1))) { list[j++] = list[i]; list[j++] = list[i + 1]; }
+  list[j] = END; W->used = j; W->stale = 0;
+  if ((W->used > INIT) && (W->max > 2 * W->used)) {
+    int max = (3 * W->used) >> 1;
+    if (W->start + W->max == S->arenaTop) S->arenaTop   -= W->max - max;
+    else                                  S->arenaWaste += W->max - max;
+    W->max = max; } }
+
+// Drops the watches of the clauses at offset end and beyond, which are all removed
+static void cutWatches (struct solver* S, struct watches *W, long end) {
+  long *list = watchList (S, W);
+  int i, j = 0;
+  for (i = 0; i < W->used; i += WATCH)
+    if ((list[i] >> 1) < end) { list[j++] = list[i]; list[j++] = list[i + 1]; }
+  W->stale -= (W->used - j) / WATCH; if (W->stale < 0) W->stale = 0;
+  list[j] = END; W->used = j; }
+
+static void sweepAllWatches (struct solver* S) {
+  int i;
+  for (i = -S->maxVar; i <= S->maxVar; i++) {
+    if (i == 0) continue;
+    if (S->wlist[i].stale) sweepWatches (S, S->wlist + i);
+    if (S->blist[i].stale) sweepWatches (S, S->blist + i); }
+  S->sweeps++; }
 
+// Drops the watch of the binary clause at offset from W, keeping the order of the others
+static void dropBinary (struct solver* S, struct watches *W, long offset) {
+  long *list = watchList (S, W);
+  int i;
+  for (i = 0; i < W->used; i += WATCH)
+    if ((list[i] >> 1) == offset) {
+      memmove (list + i, list + i + WATCH, sizeof (long) * (W->used - i - WATCH + 1));
+      W->used -= WATCH; return; } }
+
+// Removal is O(1) for longer clauses: the clause is flagged and its watches are swept
+// out in a batch once they make up half of the list.  propagate() and the list scans
+// skip them until then.  The watches of a binary clause are dropped at once, so that
+// propagate() does not read a binary clause to see whether it was removed
 static inline void removeWatch (struct solver* S, int* clause, int index) {
-  int i, lit = clause[index];
-  if ((S->used[lit] > INIT) && (S->max[lit] > 2 * S->used[lit])) {
-    S->max[lit] = (3 * S->used[lit]) >> 1;
-    S->wlist[lit] = (long *) realloc (S->wlist[lit], sizeof (long) * S->max[lit]);
-    assert(S->wlist[lit] != NULL); }
-  long *watch = S->wlist[lit];
-  for (i = 0; i < S->used[lit]; i++) {
-    int* _clause = S->DB + (*(watch++) >> 1);
-    if (_clause == clause) {
-      watch[-1] = S->wlist[lit][ --S->used[lit] ];
-      S->wlist[lit][ S->used[lit] ] = END; return; } } }
+  *removedField (S, clause) = S->sweeps + 1;
+  if (!clause[2]) { dropBinary (S, S->blist + watched (S, clause)[index], clause - S->DB); return; }
+  struct watches *W = S->wlist + watched (S, clause)[index];
+  if (2 * WATCH * ++W->stale > W->used) sweepWatches (S, W); }
+
+static inline void pushOccurs (struct solver* S, int lit, long offset) {
+  struct occurs *O = S->occurs + lit;
+  if (O->used == O->max) {
+    O->max = O->max ? (O->max * 3) >> 1 : INIT;
+    O->list = (long *) realloc (O->list, sizeof (long) * O->max);
+    if (O->list == NULL) { printf("c MEMOUT: reallocation of occurrence list failed\n"); exit (0); } }
+  O->list[ O->used++ ] = offset; }
+
+static inline void addOccurs (struct solver* S, int* clause) {
+  if (!S->occursBuilt) return;
+  long offset = clause - S->DB;
+  while (*clause) pushOccurs (S, *clause++, offset); }
+
+// Clauses leave the index mostly in the reverse order in which they joined it, so the
+// lists are searched from the end.  The order of the remaining entries is kept
+static inline void removeOccurs (struct solver* S, int* clause) {
+  if (!S->occursBuilt) return;
+  long offset = clause - S->DB;
+  while (*clause) {
+    struct occurs *O = S->occurs + *clause++;
+    int i = O->used;
+    while (i-- > 0)
+      if (O->list[i] == offset) {
+        memmove (O->list + i, O->list + i + 1, sizeof (long) * (O->used - i - 1));
+        O->used--; break; } } }
+
+// Fills the occurrence lists with the clauses that are currently watched
+static void buildOccurs (struct solver* S) {
+  int i, j;
+  for (i = -S->maxVar; i <= S->maxVar; i++)
+    if (i) S->occurs[i].used = 0;
+  S->occursBuilt = 1;
+  for (i = -S->maxVar; i <= S->maxVar; i++) {
+    if (i == 0) continue;
+    for (j = 0; j < S->wlist[i].used + S->blist[i].used; j += WATCH) {
+      long *watch = j < S->wlist[i].used ? watchList (S, S->wlist + i) + j
+                                         : watchList (S, S->blist + i) + j - S->wlist[i].used;
+      int *clause = S->DB + (*watch >> 1);
+      if (watched (S, clause)[0] == i && !*removedField (S, clause)) addOccurs (S, clause); } } }
 
 static inline void addUnit (struct solver* S, long index) {
   S->unitStack[S->unitSize++] = index; }
@@ -240,28 +865,53 @@ static inline void unassignUnit (struct solver* S, int lit) {
   S->processed = S->assigned = S->forced; }
 
 static inline void markWatch (struct solver* S, int* clause, int index, int offset) {
-  long* watch = S->wlist[ clause[ index ] ];
-  for (;;) {
-    int *_clause = (S->DB + (*(watch++) >> 1) + (long) offset);
-    if (_clause == clause) { watch[ID] |= ACTIVE; return; } } }
+  int *start = clause - offset;
+  long* watch = watchList (S, (start[2] ? S->wlist : S->blist) + watched (S, start)[ index + offset ]);
+  for (;; watch += WATCH) {
+    int *_clause = (S->DB + (*watch >> 1) + (long) offset);
+    if (_clause == clause) { *watch |= ACTIVE; return; } } }
 
-static inline void addDependency (struct solver* S, int dep, int forced) {
+static inline void addDependency (struct solver* S, long dep, int forced) {
   if (1 || S->traceFile || S->lratFile) { // temporary for MAXDEP
     if (S->nDependencies == S->maxDependencies) {
       S->maxDependencies = (S->maxDependencies * 3) >> 1;
 //      printf ("c dependencies increased to %i\n", S->maxDependencies);
-      S->dependencies = (int*)realloc (S->dependencies, sizeof (int) * S->maxDependencies);
+      S->dependencies = (long*)realloc (S->dependencies, sizeof (long) * S->maxDependencies);
       if (S->dependencies == NULL) { printf ("c MEMOUT: dependencies reallocation failed\n"); exit (0); } }
 //    printf("c adding dep %i\n", (dep << 1) + forced);
     S->dependencies[S->nDependencies++] = (dep << 1) + forced; } }
 
+static inline void activateClause (struct solver* S, int* clause, int index) {
+  S->nActive++;
+  setActive (S, clause + index);
+  if (S->markLog) S->markLog->push_back ((long) (clause - S->DB) + index);
+
+  if ((S->mode == BACKWARD_UNSAT) && clause[index + 1] && !S->result) {
+    S->optproof[S->nOpt++] = (((long) (clause - S->DB) + index) << INFOBITS) + 1; }
+  if (clause[1 + index] == 0) return;
+  markWatch (S, clause,     index, -index);
+  markWatch (S, clause, 1 + index, -index); }
+
+// Lines are kept for LRAT, and in forward mode also to work out the core lemmas
+static int keepLRATlines (struct solver *S) {
+  return S->lratFile || (S->mode == FORWARD_UNSAT && S->lemmaStr); }
+
+// A forward lemma can contain literals falsified by the top-level units.  The reasons
+// of those are satisfied by the negated lemma, so they are no LRAT hints.  The
+// literals of the lemma carry its stamp in setMap (see redundancyCheck)
+static int satisfiedHint (struct solver* S, int* clause) {
+  for (; *clause; clause++)
+    if (S->setMap[-*clause] == S->lemmaStamp) return 1;
+  return 0; }
+
 static inline void markClause (struct solver* S, int* clause, int index,
                                int64_t conflict_no, unordered_map<HitData, int>* ret_anc_data) {
   S->nResolve++;
-  addDependency (S, clause[index - 1] >> 1, (S->assigned > S->forced));
+  if (S->mode != FORWARD_UNSAT || S->current == NULL || !keepLRATlines (S) || !satisfiedHint (S, clause + index))
+    addDependency (S, clauseID (clause + index), (S->assigned > S->forced));
 
   //Take care that the ancestor(s) were used
-  int64_t anc_data_at = get_at(clause+index, ANC_DATA_AT);
+  int64_t anc_data_at = getAncAt (S, clause+index);
   if (anc_data_at != 0 && S->anc_cl_used_file != NULL) {
     const auto& anc_data =S->anc_datas[anc_data_at];
     for(const auto& a: anc_data) {
@@ -293,12 +943,12 @@ static inline void markClause (struct solver* S, int* clause, int index,
   }
 
   //Take care that the clause itself was used
-  int64_t clause_id = get_at(clause+index, CLID);
+  int64_t clause_id = getCLID (S, clause+index);
   if (clause_id != 0) {
       assert(conflict_no >= 0 && "RAT clauses, i.e. BVA cannot be used while tracking clause usefulness. There is some weird optimisation in drat-trim that marks these clauses as having been used at conflict number '-1'.... sorry, can't debug.");
       if(ret_anc_data != NULL) {
           S->anc_assigned++;
-          HitData h(clause_id, get_at(clause+index, CONFLICT_NO));
+          HitData h(clause_id, getConflictNo (S, clause+index));
           (*ret_anc_data)[h] = 1; //lowest depth, so no need to check for minimality
       }
       if (S->cl_used_file != NULL && S->anc_cl_used_file != NULL) {
@@ -323,7 +973,7 @@ static inline void markClause (struct solver* S, int* clause, int index,
           }
       }
 
-      int64_t clause_creation_confl = get_at(clause+index, CONFLICT_NO);
+      int64_t clause_creation_confl = getConflictNo (S, clause+index);
 //       printf("clid: %-10" PRId64 " cl creation confl no: %-10" PRId64
 //              " used at confl no: %-10" PRId64 "\n",
 //              this_clause_id, clause_creation_confl, conflict_no);
@@ -334,16 +984,15 @@ static inline void markClause (struct solver* S, int* clause, int index,
     }
   }
 
-  if ((clause[index + ID] & ACTIVE) == 0) {
-    S->nActive++;
-    clause[index + ID] |= ACTIVE;
+  if (S->result) S->result->marks.push_back ((long) (clause - S->DB) + index);
 
-    if ((S->mode == BACKWARD_UNSAT) && clause[index + 1]) {
-      S->optproof[S->nOpt++] = (((long) (clause - S->DB) + index) << INFOBITS) + 1; }
-    if (clause[1 + index] == 0) return;
-    markWatch (S, clause,     index, -index);
-    markWatch (S, clause, 1 + index, -index); }
-  while (*clause) S->falsified[*(clause++)] = MARK; }
+  if (!isActive (S, clause + index)) {
+    activateClause (S, clause, index);
+    if (clause[1 + index] == 0) return; }
+  // The literal that a reason implies is true, so this does not depend on where
+  // propagate () keeps it
+  for (clause += index; *clause; clause++)
+    if (S->falsified[*clause]) S->falsified[*clause] = MARK; }
 
 // Mark all clauses involved in conflict
 void analyze (struct solver* S, int* clause, int index, int64_t conflict_no,
@@ -382,35 +1031,64 @@ int propagate (struct solver* S, int init, int mark, int64_t conflict_no,
 { // Performs unit propagation (init not used?)
   int *start[2];
   int check = 0, mode = !S->prep;
-  int i, lit, _lit = 0; long *watch, *_watch;
+  int i, lit, _lit = 0; long *watch, *binary, _watch = 0, _binary = 0; // resume positions of _lit
   start[0] = start[1] = S->processed;
   flip_check:;
   check ^= 1;
   while (start[check] < S->assigned) {                 // While unprocessed false literals
     lit = *(start[check]++);                           // Get first unprocessed literal
-    if (lit == _lit) watch = _watch;
-    else watch = S->wlist[ lit ];                      // Obtain the first watch pointer
+    binary = watchList (S, S->blist + lit);            // Obtain the first binary and
+    watch  = watchList (S, S->wlist + lit);            // watch pointers
+    if (lit == _lit) { binary += _binary; watch += _watch; }
+    // The binary watches of lit live in blist and are visited before those in wlist
+    for (; *binary != END; binary += WATCH) {          // Binary clauses first, without reading them
+      if ((*binary & mode) != check) continue;
+      int other = binary[1];
+      if (S->falsified[ -other ]) continue;            // Satisfied by the other literal
+      int *clause = S->DB + (*binary >> 1);
+      if (!S->falsified[ other ]) {                    // Unit: keep the implied literal in front
+        int *lits = watched (S, clause);
+        lits[0] = other; lits[1] = lit;
+        assign (S, other);
+        S->reason[abs (other)] = ((long) ((clause)-S->DB)) + 1;
+        if (!check) {
+          start[0]--; _lit = lit; _binary = binary + WATCH - watchList (S, S->blist + lit); _watch = 0;
+          goto flip_check; } }
+      else if (!mark) { noAnalyze (S); return UNSAT; }
+      else {
+        analyze (S, clause, 0, conflict_no, ret_anc_data);
+        return UNSAT; } }
     while (*watch != END) {                            // While there are watched clauses (watched by lit)
      if ((*watch & mode) != check) {
-        watch++; continue; }
+        watch += WATCH; continue; }
+     // A true blocker satisfies the clause, so its watch stays in this list unread
+     if (S->falsified[ -watch[1] ]) {                  // Skip if the blocking literal is true
+        watch += WATCH; continue; }
      int *clause = S->DB + (*watch >> 1);	       // Get the clause from DB
-     if (S->falsified[ -clause[0] ] ||
-         S->falsified[ -clause[1] ]) {
-       watch++; continue; }
-     if (clause[0] == lit) clause[0] = clause[1];      // Ensure that the other watched literal is in front
-     for (i = 2; clause[i]; ++i)                       // Scan the non-watched literals
-        if (S->falsified[ clause[i] ] == 0) {              // When clause[j] is not false, it is either true or unset
-          clause[1] = clause[i]; clause[i] = lit;      // Swap literals
-          addWatchPtr (S, clause[1], *watch);          // Add the watch to the list of clause[1]
-          *watch = S->wlist[lit][ --S->used[lit] ];    // Remove pointer
-          S->wlist[lit][ S->used[lit] ] = END;
+     if (*removedField (S, clause)) { watch += WATCH; continue; }
+     int *lits = watched (S, clause);                  // In front of the clause, unless S->DB is shared
+     if (S->falsified[ -lits[0] ]) { watch[1] = lits[0]; watch += WATCH; continue; }
+     if (S->falsified[ -lits[1] ]) { watch[1] = lits[1]; watch += WATCH; continue; }
+     if (lits[0] == lit) lits[0] = lits[1];            // Ensure that the other watched literal is in front
+     for (i = S->view ? 0 : 2; clause[i]; ++i)         // Scan the non-watched literals
+        if (S->falsified[ clause[i] ] == 0 && clause[i] != lits[0]) { // When clause[j] is not false, it is either true or unset
+          lits[1] = clause[i];                         // Swap literals
+          if (!S->view) clause[i] = lit;
+          long pos = watch - watchList (S, S->wlist + lit); // The arena may move
+          addWatchPtr (S, lits[1], *watch, lits[0]);   // Add the watch to the list of lits[1]
+          long *list = watchList (S, S->wlist + lit);
+          watch = list + pos;
+          S->wlist[lit].used -= WATCH;                 // Remove pointer
+          watch[0] = list[ S->wlist[lit].used     ];
+          watch[1] = list[ S->wlist[lit].used + 1 ];
+          list[ S->wlist[lit].used ] = END;
           goto next_clause; }                          // Goto the next watched clause
-      clause[1] = lit; watch++;                        // Set lit at clause[1] and set next watch
-      if (!S->falsified[  clause[0] ]) {                   // If the other watched literal is falsified,
-        assign (S, clause[0]);                         // A unit clause is found, and the reason is set
-        S->reason[abs (clause[0])] = ((long) ((clause)-S->DB)) + 1;
+      lits[1] = lit; watch += WATCH;                   // Set lit at lits[1] and set next watch
+      if (!S->falsified[  lits[0] ]) {                     // If the other watched literal is falsified,
+        assign (S, lits[0]);                           // A unit clause is found, and the reason is set
+        S->reason[abs (lits[0])] = ((long) ((clause)-S->DB)) + 1;
         if (!check) {
-          start[0]--; _lit = lit; _watch = watch;
+          start[0]--; _lit = lit; _binary = S->blist[lit].used; _watch = watch - watchList (S, S->wlist + lit);
           goto flip_check; } }
       else if (!mark) { noAnalyze (S); return UNSAT; }
       else {
@@ -451,6 +1129,31 @@ int sortSize (struct solver *S, int *lemma) {
       lemma[size++] = lit; } }
   return sat * size; }
 
+// sortSize () for a clause in S->DB.  If S->DB is shared, the clause stays as it is,
+// and the literals that sortSize () would put in front become the watched ones
+static int watchSize (struct solver *S, int *clause) {
+  if (S->view == NULL) return sortSize (S, clause);
+  int *lits = S->view[clauseID (clause)].lits;
+  int i, n = 0, size = 0, sat = 1;
+  for (i = 0; clause[i]; i++)
+    if (S->falsified[clause[i]] == 0) {
+      if (S->falsified[-clause[i]]) sat = -1;
+      if (size++ < 2) lits[n++] = clause[i]; }
+  for (i = 0; n < 2 && clause[i]; i++)
+    if (S->falsified[clause[i]]) lits[n++] = clause[i];
+  return sat * size; }
+
+// Copies a lemma of S->DB with its header to S->scratch, where a thread that shares
+// S->DB can reorder and shorten it while checking it
+static int *copyLemma (struct solver *S, int *clause) {
+  int header = EXTRA - 1 + (clause[ID] < 0), size = 0;
+  while (clause[size]) size++;
+  if (S->scratch == NULL) {
+    S->scratch = (int *) malloc (sizeof (int) * (S->maxSize + EXTRA + 1));
+    if (S->scratch == NULL) { printf ("c MEMOUT: allocation of lemma copy failed\n"); exit (0); } }
+  memcpy (S->scratch, clause - header, sizeof (int) * (header + size + 1));
+  return S->scratch + header; }
+
 // print the core clauses to coreFile in DIMACS format
 void printCore (struct solver *S) {
   int i, j;
@@ -460,39 +1163,103 @@ void printCore (struct solver *S) {
   printf ("c %i of %li clauses in core                            \n", S->COREcount, S->nClauses);
 
   if (S->coreStr) {
-    FILE *coreFile = fopen (S->coreStr, "w");
-    fprintf (coreFile, "p cnf %i %i\n", S->nVars, S->COREcount);
+    struct writer *coreFile = openWriter (fopen (S->coreStr, "w"));
+    writeString (coreFile, "p cnf ");
+    writeNumber (coreFile, S->nVars, ' ');
+    writeNumber (coreFile, S->COREcount, '\n');
     for (i = 0; i < S->nClauses; i++) {
       int *clause = S->DB + (S->formula[i] >> INFOBITS);
       if (clause[ID] & ACTIVE) {
-        while (*clause) fprintf (coreFile, "%i ", *clause++);
-        fprintf (coreFile, "0\n"); } }
-    fclose (coreFile); } }
+        while (*clause) writeNumber (coreFile, *clause++, ' ');
+        writeString (coreFile, "0\n"); } }
+    freeWriter (coreFile); } }
 
-void write_lit (struct solver *S, int lit) { // change to long?
-  unsigned int l = abs (lit) << 1;
-  if (lit < 0) l++;
+void write_lit (struct solver *S, long lit) {
+  writeLiteral (S->lratFile, lit, 1); }
 
-  do {
-    if (l <= 127) { fputc ((char)                 l, S->lratFile); }
-    else          { fputc ((char) (128 + (l & 127)), S->lratFile); }
-    S->nWrites++;
-    l = l >> 7; }
-  while (l); }
-
-void printLRATline (struct solver *S, int time) {
-  int *line = S->lratTable + S->lratLookup[time];
+// The 6-byte clause ID and conflict number that read_id () expects after a lemma in a
+// binary proof with clause IDs
+static void write_id (struct writer *W, int64_t id) {
+  int i;
+  for (i = 0; i < 6; i++) writeChar (W, (char) ((id >> (8 * i)) & 255)); }
+
+// The empty clause that ends the lemma file
+static void printEmptyLemma (struct solver *S, struct writer *lemmaFile) {
   if (S->binOutput) {
-    fputc ('a', S->lratFile); S->nWrites++;
-    while (*line) write_lit (S, *line++);
+    writeChar (lemmaFile, 'a'); writeVarint (lemmaFile, 0);
+    if (S->cl_ids) write_id (lemmaFile, 0), write_id (lemmaFile, 0); }
+  else writeString (lemmaFile, "0\n"); }
+
+void lratAdd (struct solver *S, long elem);
+
+// Decodes the compact line at byte at into the free part of S->lratTable
+static int *expandLine (struct solver *S, long at) {
+  const unsigned char *in = (S->lratMap ? (const unsigned char *) S->lratMap : S->lratBytes) + at;
+  long from = S->lratSize, prev = 0;
+  int zeros = 0;
+  while (zeros < 2) { // a line ends with its second 0
+    unsigned long u = 0;
+    int shift = 0;
+    do { u |= (unsigned long) (*in & 127) << shift; shift += 7; } while (*in++ > 127);
+    prev += (long) (u >> 1) ^ -(long) (u & 1);
+    lratAdd (S, prev);
+    if (prev == 0) zeros++; }
+  S->lratSize = from;
+  return S->lratTable + from; }
+
+// The number at *line in an LRAT line, which is then moved past it
+static inline long lratNext (int **line) {
+  int *at = *line;
+  if (*at != WIDEMARK) { *line = at + 1; return *at; }
+  *line = at + 3;
+  return ((long) at[1] << 32) | (unsigned int) at[2]; }
+
+// Maps the spilled LRAT lines into memory for lratLine ().  They are read back through
+// the page cache
+static void mapLRAT (struct solver *S) {
+#ifdef HAVE_MMAP
+  if (S->lratSpill == NULL || S->lratMap) return;
+  flushWriter (S->lratSpill); fflush (S->lratSpill->file);
+  S->lratMapSize = S->lratSpill->written;
+  void *map = mmap (NULL, S->lratMapSize, PROT_READ, MAP_PRIVATE, fileno (S->lratSpill->file), 0);
+  if (map == MAP_FAILED) { printf ("c ERROR: could not map the spilled LRAT dependencies\n"); exit (0); }
+  S->lratMap = (char *) map;
+#endif
+}
+
+static void unmapLRAT (struct solver *S) {
+#ifdef HAVE_MMAP
+  if (S->lratMap) munmap (S->lratMap, S->lratMapSize);
+  S->lratMap = NULL;
+#endif
+}
+
+#ifdef HAVE_MMAP
+// Empties the spill file for the lines of another -O iteration
+static void rewindSpill (struct writer *W) {
+  W->used = W->written = 0;
+  rewind (W->file);
+  if (ftruncate (fileno (W->file), 0)) printf ("c WARNING: could not truncate the LRAT spill file\n"); }
+#endif
+
+// The LRAT line of clause time: its ID, literals and 0, then its hints and 0
+static int *lratLine (struct solver *S, long time) {
+  if (S->compactLRAT) return expandLine (S, S->lratLookup[time]);
+  return (S->lratMap ? (int *) S->lratMap : S->lratTable) + S->lratLookup[time]; }
+
+void printLRATline (struct solver *S, long time) {
+  int *line = lratLine (S, time);
+  if (S->binOutput) {
+    writeChar (S->lratFile, 'a');
+    while (*line) write_lit (S, lratNext (&line));
     write_lit (S, *line++);
-    while (*line) write_lit (S, *line++);
+    while (*line) write_lit (S, lratNext (&line));
     write_lit (S, *line++); }
   else {
-    while (*line) fprintf (S->lratFile, "%i ", *line++);
-    fprintf (S->lratFile, "%i ", *line++);
-    while (*line) fprintf (S->lratFile, "%i ", *line++);
-    fprintf (S->lratFile, "%i\n", *line++); } }
+    while (*line) writeNumber (S->lratFile, lratNext (&line), ' ');
+    writeNumber (S->lratFile, *line++, ' ');
+    while (*line) writeNumber (S->lratFile, lratNext (&line), ' ');
+    writeNumber (S->lratFile, *line++, '\n'); } }
 
 // print the core lemmas to lemmaFile in DRAT format
 void printProof (struct solver *S) {
@@ -500,13 +1267,13 @@ void printProof (struct solver *S) {
   printf ("c %i of %i lemmas in core using %lu resolution steps\n", S->nActive - S->COREcount + 1, S->nLemmas + 1, S->nResolve);
   printf ("c %d RAT lemmas in core; %i redundant literals in core lemmas\n", S->RATcount, S->nRemoved);
 
-  // NB: not yet working with forward checking
-  if (S->mode == FORWARD_UNSAT) {
-    printf ("c optimized proofs are not supported for forward checking\n");
+  // forward checking only knows the core lemmas from the LRAT lines (see forwardCore)
+  if (S->mode == FORWARD_UNSAT && !keepLRATlines (S)) {
+    printf ("c optimized proofs are only supported for forward checking with -L or -l\n");
     return; }
 
   // replace S->proof by S->optproof
-  if (S->mode == BACKWARD_UNSAT) {
+  if (S->mode == BACKWARD_UNSAT || S->mode == FORWARD_UNSAT) {
     if (S->nOpt > S->nAlloc) {
       S->nAlloc = S->nOpt;
       S->proof = (long*) realloc (S->proof, sizeof (long) * S->nAlloc);
@@ -521,19 +1288,20 @@ void printProof (struct solver *S) {
       S->proof[S->nStep++] = S->optproof[step]; } }  // why not reuse ad?
 
   if (S->lemmaStr) {
-    FILE *lemmaFile = fopen (S->lemmaStr, "w");
+    struct writer *lemmaFile = openWriter (fopen (S->lemmaStr, "w"));
     for (step = 0; step < S->nStep; step++) {
       long ad = S->proof[step];
       int *lemmas = S->DB + (ad >> INFOBITS);
       if (!lemmas[1] && (ad & 1)) continue; // don't delete unit clauses
-      if (ad & 1) fprintf (lemmaFile, "d ");
+      if (S->binOutput) writeChar (lemmaFile, (ad & 1) ? 'd' : 'a');
+      else if (ad & 1) writeString (lemmaFile, "d ");
       int reslit = lemmas[PIVOT];
 
       //prints reslit
       while (*lemmas) {
         int lit = *lemmas++;
         if (lit == reslit)
-            fprintf (lemmaFile, "%i ", lit);
+            writeLiteral (lemmaFile, lit, S->binOutput);
       }
       lemmas = S->DB + (ad >> INFOBITS);
 
@@ -541,17 +1309,30 @@ void printProof (struct solver *S) {
       while (*lemmas) {
         int lit = *lemmas++;
         if (lit != reslit)
-          fprintf (lemmaFile, "%i ", lit);
+          writeLiteral (lemmaFile, lit, S->binOutput);
       }
       //end-of-clause 0
-      fprintf (lemmaFile, "0");
+      if (S->binOutput) {
+        writeVarint (lemmaFile, 0);
+        lemmas = S->DB + (ad >> INFOBITS);
+        if (S->cl_ids && !(ad & 1))
+          write_id (lemmaFile, getCLID (S, lemmas)), write_id (lemmaFile, getConflictNo (S, lemmas)); }
+      else writeString (lemmaFile, "0\n");
     }
-    fprintf (lemmaFile, "0\n");
-    fclose (lemmaFile);
+    printEmptyLemma (S, lemmaFile);
+    freeWriter (lemmaFile);
   }
 
   if (S->lratFile) {
-    int lastAdded = S->nClauses;
+    double start = wallTime ();
+    if (S->compactLRAT)
+      printf ("c compact LRAT dependencies take %.2f MB instead of %.2f MB\n",
+              (S->lratSpill ? S->lratSpill->written + S->lratSpill->used : S->lratBytesSize) / 1048576.0,
+              S->lratInts * sizeof (int) / 1048576.0);
+    mapLRAT (S);
+    if (S->lratMap)
+      printf ("c reading %.2f MB of spilled LRAT dependencies\n", S->lratMapSize / 1048576.0);
+    long lastAdded = S->nClauses;
     int flag = 0;
     for (step = 0; step < S->nStep; step++) {
       long ad = S->proof[step];
@@ -561,52 +1342,58 @@ void printProof (struct solver *S) {
           if (S->binOutput) {
             write_lit (S, 0); }
           else {
-            fprintf (S->lratFile, "0\n"); } }
-        lastAdded = lemmas[ID] >> 1;
+            writeString (S->lratFile, "0\n"); } }
+        lastAdded = clauseID (lemmas);
         printLRATline (S, lastAdded); }
       else if (lastAdded == S->nClauses) continue;
       else if (!lemmas[1] && (ad & 1)) continue; // don't delete unit clauses
       else if (ad & 1) {
         if (lastAdded != 0) {
           if (S->binOutput) {
-            fputc ('d', S->lratFile); S->nWrites++; }
+            writeChar (S->lratFile, 'd'); }
           else {
-            fprintf (S->lratFile, "%i d ", lastAdded); } }
+            writeNumber (S->lratFile, lastAdded, ' ');
+            writeString (S->lratFile, "d "); } }
         lastAdded = 0;
         if (S->binOutput) {
-          write_lit (S, lemmas[ID] >> 1); }
+          write_lit (S, clauseID (lemmas)); }
         else {
-          fprintf (S->lratFile, "%i ", lemmas[ID] >> 1); } } }
+          writeNumber (S->lratFile, clauseID (lemmas), ' '); } } }
     if (lastAdded != S->nClauses) {
       if (S->binOutput) {
         write_lit (S, 0); }
       else {
-        fprintf(S->lratFile, "0\n"); } }
+        writeString (S->lratFile, "0\n"); } }
 
     printLRATline (S, S->count);
+    unmapLRAT (S);
 
-    fclose (S->lratFile);
+    closeWriter (S->lratFile);
+    S->nWrites = S->lratFile->written;
+    double time = wallTime () - start;
     if (S->nWrites)
-      printf ("c wrote optimized proof in LRAT format of %li bytes\n", S->nWrites); } }
+      printf ("c wrote optimized proof in LRAT format of %li bytes (%.2f MB/s)\n",
+              S->nWrites, time > 0 ? S->nWrites / time / 1048576.0 : 0.0); } }
 
 void printNoCore (struct solver *S) {
   if (S->lratFile) {
     if (S->binOutput) {
-      fputc ('d', S->lratFile); S->nWrites++; }
+      writeChar (S->lratFile, 'd'); }
     else {
-      fprintf (S->lratFile, "%ld d ", S->nClauses); }
+      writeNumber (S->lratFile, S->nClauses, ' ');
+      writeString (S->lratFile, "d "); }
     int i;
     for (i = 0; i < S->nClauses; i++) {
       int *clause = S->DB + (S->formula[i] >> INFOBITS);
       if ((clause[ID] & ACTIVE) == 0) {
         if (S->binOutput) {
-          write_lit (S, clause[ID] >> 1); }
+          write_lit (S, clauseID (clause)); }
         else {
-          fprintf (S->lratFile, "%i ", clause[ID] >> 1); } } }
+          writeNumber (S->lratFile, clauseID (clause), ' '); } } }
     if (S->binOutput) {
       write_lit (S, 0); }
     else {
-      fprintf (S->lratFile, "0\n"); } } }
+      writeString (S->lratFile, "0\n"); } } }
 
 // print the dependency graph to traceFile in TraceCheck+ format
 // this procedure adds the active clauses at the end of the trace
@@ -615,22 +1402,25 @@ void printTrace (struct solver *S) {
     for (i = 0; i < S->nClauses; i++) {
       int *clause = S->DB + (S->formula[i] >> INFOBITS);
       if (clause[ID] & ACTIVE) {
-        fprintf (S->traceFile, "%i ", i + 1);
-        while (*clause) fprintf (S->traceFile, "%i ", *clause++);
-        fprintf (S->traceFile, "0 0\n"); } }
-    fclose (S->traceFile); } }
+        writeNumber (S->traceFile, i + 1, ' ');
+        while (*clause) writeNumber (S->traceFile, *clause++, ' ');
+        writeString (S->traceFile, "0 0\n"); } }
+    closeWriter (S->traceFile); } }
 
 void printActive (struct solver *S) {
   int i, j;
   if (S->activeFile) {
     for (i = -S->maxVar; i <= S->maxVar; i++)
       if (i != 0)
-        for (j = 0; j < S->used[i]; j++) {
-          int *clause = S->DB + (S->wlist[i][j] >> 1);
-          if (*clause == i) {
+        for (j = 0; j < S->wlist[i].used + S->blist[i].used; j += WATCH) {
+          long *watch = j < S->wlist[i].used ? watchList (S, S->wlist + i) + j
+                                             : watchList (S, S->blist + i) + j - S->wlist[i].used;
+          int *clause = S->DB + (*watch >> 1);
+          if (*clause == i && !clause[REMOVED]) {
             while (*clause)
-              fprintf (S->activeFile, "%i ", *clause++);
-            fprintf (S->activeFile, "0\n"); } } } }
+              writeNumber (S->activeFile, *clause++, ' ');
+            writeString (S->activeFile, "0\n"); } }
+    flushWriter (S->activeFile); } }
 
 void postprocess (struct solver *S) {
   printNoCore (S);   // print before proof optimization
@@ -641,30 +1431,62 @@ void postprocess (struct solver *S) {
   printf("c Num anc assigned: %ld anc_anc assigned: %ld\n", S->anc_assigned, S->anc_anc_assigned);
 }
 
-void lratAdd (struct solver *S, int elem) {
-  if (S->lratSize == S->lratAlloc) {
+// Appends elem to S->lratTable, as WIDEMARK and its two halves if it is no int
+void lratAdd (struct solver *S, long elem) {
+  if (S->lratSize + 3 > S->lratAlloc) {
     S->lratAlloc = S->lratAlloc * 3 >> 1;
-    S->lratTable = (int *) realloc (S->lratTable, sizeof (int) * S->lratAlloc); }
-  S->lratTable[S->lratSize++] = elem; }
+    S->lratTable = (int *) realloc (S->lratTable, sizeof (int) * S->lratAlloc);
+    if (S->lratTable == NULL) { printf ("c MEMOUT: reallocation of LRAT table failed\n"); exit (0); } }
+  if (elem > INT_MIN && elem <= INT_MAX) { S->lratTable[S->lratSize++] = elem; return; }
+  S->lratTable[S->lratSize++] = WIDEMARK;
+  S->lratTable[S->lratSize++] = elem >> 32;
+  S->lratTable[S->lratSize++] = (int) (elem & 0xffffffff); }
+
+// Replaces the line lratTable[from..lratSize) by its compact form in lratBytes, or in
+// the spill file.  Each number is stored as the difference to the one before, most of
+// all to keep the nearly sorted clause IDs of the hints small, as a zigzag varint
+// (0, -1, 1, -2, ... become 0, 1, 2, 3, ...)
+static void compactLine (struct solver *S, long *lookup, long from) {
+  long prev = 0, need = S->lratBytesSize + 10 * (S->lratSize - from);
+  if (need > S->lratBytesAlloc) {
+    S->lratBytesAlloc = std::max (need, S->lratBytesAlloc * 3 >> 1);
+    S->lratBytes = (unsigned char *) realloc (S->lratBytes, S->lratBytesAlloc);
+    if (S->lratBytes == NULL) { printf ("c MEMOUT: reallocation of compact LRAT table failed\n"); exit (0); } }
+  unsigned char *start = S->lratBytes + S->lratBytesSize, *out = start;
+  int *line = S->lratTable + from;
+  while (line < S->lratTable + S->lratSize) {
+    long number = lratNext (&line), delta = number - prev;
+    unsigned long u = ((unsigned long) delta << 1) ^ (unsigned long) (delta >> 63);
+    for (; u > 127; u >>= 7) *out++ = (unsigned char) (128 + (u & 127));
+    *out++ = (unsigned char) u;
+    prev = number; }
+  S->lratInts += S->lratSize - from;
+  S->lratSize = from;
+  if (S->lratSpill) { // lratBytes only holds this line then
+    *lookup = S->lratSpill->written + S->lratSpill->used;
+    writeBytes (S->lratSpill, start, out - start); }
+  else {
+    *lookup = start - S->lratBytes;
+    S->lratBytesSize = out - S->lratBytes; } }
 
 void printDependenciesFile (struct solver *S, int* clause, int RATflag, int mode) {
-  FILE *file = NULL;
-  if (mode == 0) file = S->traceFile;
-  if (mode == 1) file = S->lratFile;
+  struct writer *file = NULL;
+  int keep = 0;
+  if (mode == 0) keep = (file = S->traceFile) != NULL;
+  if (mode == 1) keep = keepLRATlines (S);
 
-  if (file) {
+  if (keep) {
     int i, j, k;
-    int tmp = S->lratSize;
+    long tmp = S->lratSize;
 
-    if (clause != NULL) {
-           S->lratLookup[clause[ID] >> 1] = S->lratSize; }
-    else { S->lratLookup[S->count] = S->lratSize;   }
+    long *lookup = S->lratLookup + (clause != NULL ? clauseID (clause) : S->count);
+    *lookup = S->lratSize;
 
     if (clause != NULL) {
       int size = 0;
       int *sortClause;
       sortClause = (int *) malloc (sizeof(int) * S->maxSize);
-      lratAdd (S, S->time >> 1); // NB: long to ing
+      lratAdd (S, S->time >> 1);
       int reslit = clause[PIVOT];
       while (*clause) {
         if (*clause == reslit)
@@ -695,7 +1517,7 @@ void printDependenciesFile (struct solver *S, int* clause, int RATflag, int mode
       if (S->dependencies[i] > 0) continue;
       for (j = i - 1; j >= 0 && S->dependencies[j] > 0; j--) {
         int flag = 0;
-        int cls  = S->dependencies[j];
+        long cls = S->dependencies[j];
         if (cls & 1) continue;
         for (k = 0; k < size; k++)
           if (S->preRAT[k] == cls) flag = 1;
@@ -705,7 +1527,7 @@ void printDependenciesFile (struct solver *S, int* clause, int RATflag, int mode
 
     // print dependencies in order of becoming unit
     for (i = S->nDependencies - 1; i >= 0; i--) {
-      int cls = S->dependencies[i];
+      long cls = S->dependencies[i];
       if ((mode == 0) && (cls < 0)) continue;
       if (mode == 0) {
         int flag = 0;
@@ -720,59 +1542,70 @@ void printDependenciesFile (struct solver *S, int* clause, int RATflag, int mode
 
     printLine:;
     if (mode == 0) {
-      for (i = tmp; i < S->lratSize; i++)
-        fprintf (file, "%d ", S->lratTable[i]);
+      int *line = S->lratTable + tmp;
+      while (line < S->lratTable + S->lratSize)
+        writeNumber (file, lratNext (&line), ' ');
       S->lratSize = tmp;
-      fprintf (file, "\n"); } } }
+      writeChar (file, '\n'); }
+    else if (S->compactLRAT) compactLine (S, lookup, tmp);
+    else if (S->lratSpill) { // only the line in progress stays in memory
+      *lookup = (S->lratSpill->written + S->lratSpill->used) / sizeof (int);
+      writeBytes (S->lratSpill, S->lratTable + tmp, sizeof (int) * (S->lratSize - tmp));
+      S->lratSize = tmp; } } }
 
 void printDependencies (struct solver *S, int* clause, int RATflag) {
+  if (S->result) { // on a checker thread the lemma is printed when it is committed
+    S->result->deps.assign (S->dependencies, S->dependencies + S->nDependencies);
+    S->result->RATflag = RATflag; return; }
   if (clause != NULL) {
     int i;
-    clause[MAXDEP] = 0;
+    long maxDep = 0;
     for (i = 0; i < S->nDependencies; i++) {
 //      printf ("%i ", S->dependencies[i]);
-      if (S->dependencies[i] > clause[MAXDEP])
-        clause[MAXDEP] = S->dependencies[i]; }
-//    printf("\n%i :", clause[MAXDEP]);
+      if (S->dependencies[i] > maxDep)
+        maxDep = S->dependencies[i]; }
+//    printf("\n%i :", maxDep);
 //    printClause(clause);
-    assert (clause[MAXDEP] < clause[ID]);
+    assert (maxDep < clauseTime (clause));
+    if (S->maxDep) S->maxDep[clauseID (clause)] = maxDep;
   }
 
   printDependenciesFile (S, clause, RATflag, 0);
   printDependenciesFile (S, clause, RATflag, 1); }
 
-int checkRAT (struct solver *S, int pivot, int mark) {
-  int i, j, nRAT = 0;
+static int splitRAT (struct solver *S, int pivot, int mark, int nRAT);
+static void freeHelpers (struct solver *S);
 
-  // Loop over all literals to calculate resolution candidates
-  for (i = -S->maxVar; i <= S->maxVar; i++) {
-    if (i == 0) continue;
-    // Loop over all watched clauses for literal
-    for (j = 0; j < S->used[i]; j++) {
-      int* watched = S->DB + (S->wlist[i][j] >> 1);
-      int id = watched[ID] >> 1;
-      int active = watched[ID] & ACTIVE;
-      if (*watched == i) { // If watched literal is in first position
-	while (*watched)
-          if (*watched++ == -pivot) {
-            if ((S->mode == BACKWARD_UNSAT) && !active) {
-//              printf ("c RAT check ignores unmarked clause : "); printClause (S->DB + (S->wlist[i][j] >> 1));
-              continue; }
-	    if (nRAT == S->maxRAT) {
-	      S->maxRAT = (S->maxRAT * 3) >> 1;
-	      S->RATset = (int*)realloc (S->RATset, sizeof (int) * S->maxRAT);
-              assert (S->RATset != NULL); }
-	    S->RATset[nRAT++] = S->wlist[i][j] >> 1;
-            break; } } } }
+int checkRAT (struct solver *S, int pivot, int mark) {
+  int i, nRAT = 0;
+  if (!S->occursBuilt) buildOccurs (S);
+
+  // Only the clauses containing -pivot are resolution candidates
+  struct occurs *O = S->occurs - pivot;
+  for (i = 0; i < O->used; i++) {
+    int* clause = S->DB + O->list[i];
+    int active = isActive (S, clause);
+    if ((S->mode == BACKWARD_UNSAT) && !active) {
+//      printf ("c RAT check ignores unmarked clause : "); printClause (clause, S);
+      continue; }
+    if (nRAT == S->maxRAT) {
+      S->maxRAT = (S->maxRAT * 3) >> 1;
+      S->RATset = (long*)realloc (S->RATset, sizeof (long) * S->maxRAT);
+      assert (S->RATset != NULL); }
+    S->RATset[nRAT++] = O->list[i]; }
 
   // S->prep = 1;
   // Check all clauses in RATset for RUP
   int flag = 1;
-  qsort (S->RATset, nRAT, sizeof (int), compare);
+  qsort (S->RATset, nRAT, sizeof (long), longcompare);
   S->nDependencies = 0;
+  if (S->ratThreads && S->backStep >= 0 && nRAT >= RATSPLIT &&
+      !S->cl_ids && !S->cl_used_file && !S->anc_cl_used_file) {
+    flag = splitRAT (S, pivot, mark, nRAT);
+    goto checked; }
   for (i = nRAT - 1; i >= 0; i--) {
     int* RATcls = S->DB + S->RATset[i];
-    int id = RATcls[ID] >> 1;
+    long id = clauseID (RATcls);
     int blocked = 0;
     long int reason  = 0;
     if (S->verb) {
@@ -797,10 +1630,12 @@ int checkRAT (struct solver *S, int pivot, int mark) {
       if (propagate (S, 0, mark, -1, NULL) == SAT) { flag  = 0; break; } }
     addDependency (S, -id, 1); }
 
+  checked:;
   if (flag == 0) {
     while (S->forced < S->assigned) {
       S->falsified[*(--S->assigned)] = 0;
       S->reason[abs (*S->assigned)] = 0; }
+    S->processed = S->forced; // the next pivot propagates its candidates from here
     if (S->verb) printf ("c RAT check on pivot %i failed\n", pivot);
     return FAILED; }
 
@@ -884,7 +1719,7 @@ int setRedundancyCheck (struct solver *S, int *clause, int size, int uni) {
   for (i = -S->maxVar; i <= S->maxVar; i++) {
     if (i == 0) continue;
     // Loop over all watched clauses for literal
-    for (j = 0; j < S->used[i]; j++) {
+    for (j = 0; j < S->used[i]; j += WATCH) {
       int* watchedClause = S->DB + (S->wlist[i][j] >> 1);
       if (*watchedClause == i) { // If watched literal is in first position
         int flag = 0;
@@ -998,8 +1833,11 @@ int redundancyCheck (struct solver *S, int *clause, int size, int mark) {
     S->reason[abs (clause[i])] = 0; }
 
   S->current = clause;
+  if (S->mode == FORWARD_UNSAT && keepLRATlines (S)) {
+    S->lemmaStamp++;
+    for (i = 0; clause[i]; i++) S->setMap[clause[i]] = S->lemmaStamp; }
   unordered_map<HitData, int> ret_anc_data; //min depth is 2nd
-  if (propagate (S, 0, mark, get_at(clause, CONFLICT_NO),
+  if (propagate (S, 0, mark, getConflictNo (S, clause),
       &ret_anc_data) == UNSAT) {
     indegree = S->nResolve - indegree;
     if (indegree <= 2 && S->prep == 0) {
@@ -1009,8 +1847,8 @@ int redundancyCheck (struct solver *S, int *clause, int size, int mark) {
     if (S->verb) printf ("c lemma has RUP\n");
     printDependencies (S, clause, 0);
 
-    int64_t clid_this = get_at(clause, CLID);
-    int64_t conflict_num_this = get_at(clause, CONFLICT_NO);
+    int64_t clid_this = getCLID (S, clause);
+    int64_t conflict_num_this = getConflictNo (S, clause);
     //Remove elements that are the same as clid_this
     //Otherwise, it'd create itself. This could only happen due to optimization and a different
     //proof than before
@@ -1036,7 +1874,7 @@ int redundancyCheck (struct solver *S, int *clause, int size, int mark) {
         ancestors.insert(a);
       }
 
-      int64_t old_anc_pos = get_at(clause, ANC_DATA_AT);
+      int64_t old_anc_pos = getAncAt (S, clause);
       if (old_anc_pos != 0) {
         if (S->verb) {
           printf("Old ancestor:"); printClause(clause, S);
@@ -1047,7 +1885,7 @@ int redundancyCheck (struct solver *S, int *clause, int size, int mark) {
         }
       } else {
         S->anc_datas.push_back(ancestors);
-        store_at(clause+ANC_DATA_AT, S->anc_datas.size()-1);
+        S->ancAt[clauseID (clause)] = S->anc_datas.size()-1;
       }
     }
     return SUCCESS; }
@@ -1063,6 +1901,7 @@ int redundancyCheck (struct solver *S, int *clause, int size, int mark) {
   int* savedForced = S->forced;
 
   S->RATmode = 1;
+  S->topLevel = S->forced;
   S->forced = S->assigned;
 
   int failed = 0;
@@ -1108,14 +1947,27 @@ int init (struct solver *S) {
   S->nActive    = 0;
   S->COREcount  = 0;
   S->unitSize   = 0;
+  S->occursBuilt = 0;
+  S->backStep   = -1;
+  S->ratSplits  = 0; S->lemmaStamp = 0;
+  S->lratSize   = 0; // the LRAT lines of an earlier -O iteration are not needed anymore
+  S->lratBytesSize = S->lratInts = 0;
+#ifdef HAVE_MMAP
+  if (S->lratSpill) rewindSpill (S->lratSpill);
+#endif
+  freeHelpers (S);
 
   int i;
   for (i = 1; i <= S->maxVar; ++i) {
     S->reason    [i]                 = 0;
     S->falseStack[i]                 = 0;
     S->falsified[i]    = S->falsified[-i]    = 0;
-    S->used [i]    = S->used [-i]    = 0;
-    S->wlist[i][0] = S->wlist[-i][0] = END; }
+    S->setMap[i]       = S->setMap[-i]       = 0;
+    S->wlist[i].used = S->wlist[-i].used = S->wlist[i].stale = S->wlist[-i].stale = 0;
+    S->blist[i].used = S->blist[-i].used = S->blist[i].stale = S->blist[-i].stale = 0;
+    *watchList (S, S->wlist + i) = *watchList (S, S->wlist - i) = END;
+    *watchList (S, S->blist + i) = *watchList (S, S->blist - i) = END; }
+  S->sweeps++;
 
   for (i = 0; i < S->nClauses; i++) {
     int *clause = S->DB + (S->formula[i] >> INFOBITS);
@@ -1127,9 +1979,9 @@ int init (struct solver *S) {
         fprintf (coreFile, "p cnf 0 1\n 0\n");
         fclose (coreFile); }
       if (S->lemmaStr) {
-        FILE *lemmaFile = fopen (S->lemmaStr, "w");
-        fprintf (lemmaFile, "0\n");
-        fclose (lemmaFile);
+        struct writer *lemmaFile = openWriter (fopen (S->lemmaStr, "w"));
+        printEmptyLemma (S, lemmaFile);
+        freeWriter (lemmaFile);
       }
       return UNSAT;
     }
@@ -1141,15 +1993,19 @@ int init (struct solver *S) {
         fprintf (coreFile, "p cnf %i 2\n%i 0\n%i 0\n", abs (clause[0]), clause[0], -clause[0]);
         fclose (coreFile); }
       if (S->lemmaStr) {
-        FILE *lemmaFile = fopen (S->lemmaStr, "w");
-        fprintf (lemmaFile, "0\n");
-        fclose (lemmaFile); }
+        struct writer *lemmaFile = openWriter (fopen (S->lemmaStr, "w"));
+        printEmptyLemma (S, lemmaFile);
+        freeWriter (lemmaFile); }
       if (S->lratFile) {
         int j;
         for (j = 0; j < i; j++) {
           int *_clause = S->DB + (S->formula[j] >> INFOBITS);
           if ((_clause[0] == -clause[0]) && !_clause[1]) break; }
-        fprintf (S->lratFile, "%li 0 %i %i 0\n", S->nClauses + 1, j + 1, i + 1); }
+        writeNumber (S->lratFile, S->nClauses + 1, ' ');
+        writeString (S->lratFile, "0 ");
+        writeNumber (S->lratFile, j + 1, ' ');
+        writeNumber (S->lratFile, i + 1, ' ');
+        writeString (S->lratFile, "0\n"); }
       return UNSAT; }
     else if (!S->falsified[ -clause[0] ]) {
       addUnit (S, (long) (clause - S->DB));
@@ -1163,12 +2019,993 @@ int init (struct solver *S) {
     postprocess (S); return UNSAT; }
   return SAT; }
 
+// fraction is the part of the lemmas that is still to be checked
+static void printProgress (double fraction, double time, int last) {
+  int f;
+  printf("c %.2f%% [", 100.0 * (1.0 - fraction));
+  for (f = 1; f <= 20; f++) {
+    if ((1.0 - fraction) * 20.0 < 1.0 * f) printf(" ");
+    else printf("="); }
+  printf("] time remaining: %.2f seconds ", time / (1.0 - fraction) - time);
+  if (last) printf("\n");
+  fflush (stdout); }
+
+// Takes proof step ad back in the backward pass: a lemma leaves the database and a
+// deleted clause returns to it.  Returns the size of the clause as sortSize() does
+static int retractStep (struct solver *S, long ad) {
+  int *clause = S->DB + (ad >> INFOBITS);
+
+  //LSB bit of "S->proof[step]"
+  if ((ad & 1) == 0) {
+    if (S->verb) {printf("d was zero for: "); printClause (clause, S);}
+    if (clause[1]) {
+      int lit = watched (S, clause)[0];
+      removeWatch (S, clause, 0), removeWatch (S, clause, 1); removeOccurs (S, clause);
+      if (S->reason[abs (lit)] == (clause + 1 - S->DB)) {  // use this check also for units?
+        unassignUnit (S, lit); } }
+    else unassignUnit (S, clause[0]); }
+
+  int size = watchSize (S, clause);
+
+  if (ad & 1) {
+    if (S->verb) { printf ("c adding clause (%i) ", size); printClause (clause, S); }
+    addWatch (S, clause, 0), addWatch (S, clause, 1); addOccurs (S, clause); }
+  return size; }
+
+// Drops the literals of a marked lemma that are falsified by the top-level units,
+// then checks it
+static int checkLemma (struct solver *S, int *clause, int size) {
+    assert (size >= 1);
+    int *_clause = clause + size;
+    while (*_clause++) { S->nRemoved++; }
+    clause[size] = 0;
+
+    if (S->verb) {
+      printf ("c validating clause (%i, %i):  ", clause[PIVOT], size); printClause (clause, S); }
+/*
+    int i;
+    if (size > 1 && (top_flag == 1)) {
+      int last = clause[size - 1];
+      int pivot = clause[PIVOT];
+      for (i = 0; i < size; i++) {
+        int tmp = clause[i];
+        clause[i] = last;
+        clause[size - 1] = 0;
+        if (tmp == pivot) clause[PIVOT] = clause[0];
+        if (redundancyCheck (S, clause, size - 1, 0) != FAILED) {
+          top_flag = 0;
+          size = size - 1; break; }
+        else {
+          clause[i] = tmp;
+          clause[size - 1] = last; }
+        clause[PIVOT] = pivot; } }
+*/
+    return redundancyCheck (S, clause, size, 1); }
+
+// active holds the ACTIVE flags by clause ID, and log the offsets of the clauses in the
+// order in which they got marked, so that each checker thread can prefer them as well
+struct backward { struct solver *S; long *steps, nLemmas; struct lemmaResult *results;
+                  std::atomic<long> *log, logSize, next, committed; std::atomic<int> abort;
+                  std::atomic<char> *active; };
+
+// The lemmas of the forward pass are handed out in windows of consecutive lemmas, so
+// that each checker thread only has to replay the proof once.  verify () appends the
+// lemmas to steps while the threads check them, and sets done after the last one
+struct forward { struct solver *S; long *steps; vector<struct checker*> checkers;
+                 struct lemmaResult *results; long window, nRemoved, RATcount, nResolve;
+                 std::atomic<long> nLemmas, next; std::atomic<int> done, abort; double start; };
+
+// The clauses of the proof steps after passed are not read by the thread anymore
+struct checker { struct solver S; struct backward *P; struct forward *F; long pos, seen; double busy;
+                 std::atomic<long> passed; std::thread thread; };
+
+// Returns a copy of the view of S, or a view of S->DB as it is if S has none
+static struct view *newView (struct solver *S) {
+  struct view *V = (struct view *) calloc (S->count + 1, sizeof (struct view));
+  if (V == NULL) { printf ("c MEMOUT: allocation of clause view failed\n"); exit (0); }
+  if (S->view) { memcpy (V, S->view, sizeof (struct view) * (S->count + 1)); return V; }
+  long s;
+  for (s = 0; s < S->nClauses + S->nStep; s++) {
+    long ad = s < S->nClauses ? S->formula[s] : S->proof[s - S->nClauses];
+    if (ad == 0 || (ad & 1)) continue;
+    int *clause = S->DB + (ad >> INFOBITS);
+    struct view *v = V + clauseID (clause);
+    v->lits[0] = clause[0]; v->lits[1] = clause[0] ? clause[1] : 0;
+    v->removed = clause[REMOVED]; v->active = clause[ID] & ACTIVE; }
+  return V; }
+
+// Gives a checker thread its own copy of everything that checking a lemma writes to.
+// It reads the clauses from S->DB and writes to a view of them (see struct view)
+static void cloneSolver (struct solver *W, struct solver *S) {
+  int n = S->maxVar;
+  *W = *S;
+  W->view = newView (S);
+  W->arena = (long *) malloc (sizeof (long) * (S->arenaSize + 1));
+  if (W->arena == NULL) { printf ("c MEMOUT: allocation of checker thread failed\n"); exit (0); }
+  memcpy (W->arena, S->arena, sizeof (long) * S->arenaTop);
+  W->falseStack = (int *) malloc (sizeof (int) * (n + 1));
+  memcpy (W->falseStack, S->falseStack, sizeof (int) * (n + 1));
+  W->forced    = W->falseStack + (S->forced    - S->falseStack);
+  W->processed = W->falseStack + (S->processed - S->falseStack);
+  W->assigned  = W->falseStack + (S->assigned  - S->falseStack);
+  W->reason = (long *) malloc (sizeof (long) * (n + 1));
+  memcpy (W->reason, S->reason, sizeof (long) * (n + 1));
+  W->falsified = (int8_t *) malloc (sizeof (int8_t) * (2 * n + 1)) + n;
+  memcpy (W->falsified - n, S->falsified - n, sizeof (int8_t) * (2 * n + 1));
+  W->setMap = (int *) calloc (2 * n + 1, sizeof (int)) + n;
+  W->wlist = (struct watches *) malloc (sizeof (struct watches) * (2 * n + 1)) + n;
+  W->blist = (struct watches *) malloc (sizeof (struct watches) * (2 * n + 1)) + n;
+  memcpy (W->wlist - n, S->wlist - n, sizeof (struct watches) * (2 * n + 1));
+  memcpy (W->blist - n, S->blist - n, sizeof (struct watches) * (2 * n + 1));
+  W->occurs = (struct occurs *) calloc (2 * n + 1, sizeof (struct occurs)) + n;
+  W->occursBuilt = 0;
+  W->unitStack = (long *) malloc (sizeof (long) * n);
+  memcpy (W->unitStack, S->unitStack, sizeof (long) * n);
+  W->RATset = (long *) malloc (sizeof (long) * S->maxRAT);
+  W->dependencies = (long *) malloc (sizeof (long) * S->maxDependencies);
+  W->current = NULL;
+  W->scratch = NULL;
+  W->result = NULL;
+  W->ratThreads = 0;
+  W->helpers = NULL;
+  W->markLog = NULL;
+  W->bar = 0; }
+
+static void freeClone (struct solver *W) {
+  int i, n = W->maxVar;
+  for (i = -n; i <= n; i++) free (W->occurs[i].list);
+  free (W->occurs - n);
+  free (W->view);
+  free (W->arena); free (W->falseStack); free (W->reason); free (W->scratch);
+  free (W->falsified - n); free (W->setMap - n); free (W->wlist - n); free (W->blist - n);
+  free (W->unitStack); free (W->RATset); free (W->dependencies); }
+
+// Takes over a mark made by another thread.  A clause that is not watched by this
+// one yet (or anymore) only gets the flag
+static inline void adoptMark (struct solver *S, long offset) {
+  int *clause = S->DB + offset;
+  if (isActive (S, clause)) return;
+  setActive (S, clause);
+  if (watched (S, clause)[1] && !*removedField (S, clause)) {
+    markWatch (S, clause, 0, 0);
+    markWatch (S, clause, 1, 0); } }
+
+// Marks the clauses that other threads marked since the last call
+static void adoptMarks (struct checker *C) {
+  struct backward *P = C->P;
+  while (C->seen < P->logSize.load (std::memory_order_acquire)) {
+    long offset = P->log[C->seen].load (std::memory_order_acquire);
+    if (offset == 0) break; // not written yet
+    C->seen++;
+    adoptMark (&C->S, offset); } }
+
+// A checker thread walks back through the proof with its own watches and assignment
+// and takes the next unclaimed lemma once it gets there.  A lemma that is not marked
+// yet can only be skipped after all later lemmas are committed, because until then
+// one of them may still mark it.  The lemma is checked on a copy, as the literals in
+// S->DB only change when the lemma is committed and no thread reads them anymore
+static void checkLemmas (struct checker *C) {
+  struct solver *S = &C->S;
+  struct backward *P = C->P;
+  double start = wallTime (), waiting = 0;
+  long q;
+  while (!P->abort && (q = P->next++) < P->nLemmas) {
+    long step = P->steps[q], ad = S->proof[step];
+    for (; C->pos >= step; C->pos--)
+      if (S->proof[C->pos]) retractStep (S, S->proof[C->pos]);
+    C->passed.store (C->pos, std::memory_order_release);
+
+    long id = clauseID (S->DB + (ad >> INFOBITS));
+    int active;
+    double wait = wallTime ();
+    for (;;) {
+      long committed = P->committed.load (std::memory_order_acquire);
+      active = P->active[id].load (std::memory_order_acquire);
+      if (active || committed >= q || P->abort) break;
+      std::this_thread::yield (); }
+    waiting += wallTime () - wait;
+
+    struct lemmaResult *R = P->results + q;
+    if (!active) { R->status.store (SKIPPED, std::memory_order_release); continue; }
+
+    adoptMarks (C);
+    int *clause = copyLemma (S, S->DB + (ad >> INFOBITS));
+    int size = sortSize (S, clause);
+    clause[ID] |= ACTIVE;
+    S->time = clauseTime (clause);
+    S->result = R;
+    int status = checkLemma (S, clause, size);
+    S->result = NULL;
+    R->pivot = clause[PIVOT];
+    for (size = 0; clause[size]; size++);
+    R->lits.assign (clause, clause + size);
+    for (long offset : R->marks)
+      if (!P->active[clauseID (S->DB + offset)].exchange (1, std::memory_order_acq_rel))
+        P->log[ P->logSize++ ].store (offset, std::memory_order_release);
+    R->status.store (status, std::memory_order_release);
+    if (status == FAILED) { P->abort = 1; break; } } // the trail of the lemma is still on S
+  C->busy = wallTime () - start - waiting; }
+
+static void setDependencies (struct solver *S, vector<long> &deps) {
+  size_t i;
+  if ((int) deps.size () > S->maxDependencies) {
+    S->maxDependencies = deps.size ();
+    S->dependencies = (long*) realloc (S->dependencies, sizeof (long) * S->maxDependencies);
+    if (S->dependencies == NULL) { printf ("c MEMOUT: dependencies reallocation failed\n"); exit (0); } }
+  S->nDependencies = deps.size ();
+  for (i = 0; i < deps.size (); i++) S->dependencies[i] = deps[i]; }
+
+// Does for a lemma checked on a checker thread what the sequential loop does while
+// checking it: newly marked clauses get their deletion in the optimized proof, and the
+// lemma its dependencies.  marked holds the ACTIVE flags as committed so far.  The
+// checked literals are printed from a copy, and only written back by writeLemma ()
+static void commitLemma (struct solver *S, int *clause, struct lemmaResult *R, vector<char> &marked) {
+  for (long offset : R->marks) {
+    int *mark = S->DB + offset;
+    long id = clauseID (mark);
+    if (marked[id]) continue;
+    marked[id] = 1; S->nActive++;
+    if (mark[1]) S->optproof[S->nOpt++] = (offset << INFOBITS) + 1; }
+
+  int *lemma = copyLemma (S, clause);
+  std::copy (R->lits.begin (), R->lits.end (), lemma);
+  lemma[R->lits.size ()] = 0;
+  lemma[PIVOT] = R->pivot;
+  S->time = clauseTime (lemma);
+  setDependencies (S, R->deps);
+  printDependencies (S, lemma, R->RATflag); }
+
+static void writeLemma (int *clause, vector<int> &lits, int pivot) {
+  size_t i;
+  for (i = 0; i < lits.size (); i++) clause[i] = lits[i];
+  clause[i] = 0;
+  clause[PIVOT] = pivot; }
+
+// The backward pass of verify() from the conflict at step on S->checkThreads threads,
+// which share S->DB.  The threads share their marks as soon as a check is done, while
+// the trimmed proof, the dependencies and the counters are committed here in proof
+// order, as in the sequential loop.  Only the choice of the clauses used in each check
+// may differ.  A committed lemma is written back once all threads have passed it
+static int backwardParallel (struct solver *S, int step) {
+  struct backward P;
+  int t, nThreads = S->checkThreads;
+  long q, s, nLemmas = 0;
+
+  P.S = S;
+  P.steps = (long *) malloc (sizeof (long) * (step + 1));
+  for (s = step; s >= 0; s--)
+    if (S->proof[s] && !(S->proof[s] & 1)) P.steps[nLemmas++] = s;
+  P.nLemmas = nLemmas;
+  P.results = new lemmaResult[nLemmas];
+  for (q = 0; q < nLemmas; q++) P.results[q].status = 0;
+  P.log = new std::atomic<long>[S->count + 1];
+  P.active = new std::atomic<char>[S->count + 1];
+  for (q = 0; q <= S->count; q++) P.log[q] = 0;
+  P.logSize = 0; P.next = 0; P.committed = 0; P.abort = 0;
+
+  vector<char> marked (S->count + 1, 0);
+  for (s = 0; s < S->nClauses; s++) {
+    int *clause = S->DB + (S->formula[s] >> INFOBITS);
+    marked[clauseID (clause)] = clause[ID] & ACTIVE; }
+  for (s = 0; s < S->nStep; s++) {
+    int *clause = S->DB + (S->proof[s] >> INFOBITS);
+    if (S->proof[s] && !(S->proof[s] & 1)) marked[clauseID (clause)] = clause[ID] & ACTIVE; }
+  for (q = 0; q <= S->count; q++) P.active[q] = marked[q];
+
+  long nRemoved = S->nRemoved, RATcount = S->RATcount, nResolve = S->nResolve, written = 0;
+  vector<struct checker*> checkers;
+  for (t = 0; t < nThreads; t++) {
+    struct checker *C = new checker;
+    cloneSolver (&C->S, S);
+    C->P = &P; C->F = NULL; C->pos = step; C->seen = 0; C->busy = 0; C->passed = step;
+    checkers.push_back (C); }
+
+  double wall = wallTime (), offset = cpuTime () - wall;
+  for (struct checker *C : checkers) C->thread = std::thread (checkLemmas, C);
+
+  int failed = 0;
+  for (q = 0; q < nLemmas; q++) {
+    struct lemmaResult *R = P.results + q;
+    int status;
+    while ((status = R->status.load (std::memory_order_acquire)) == 0) {
+      int seconds = (int) (wallTime () + offset) - S->start_time;
+      if ((seconds > S->timeout) && (S->optimize == 0)) printf ("s TIMEOUT\n"), exit (0);
+      std::this_thread::yield (); }
+
+    if (S->bar && (q % 1000) == 0)
+      printProgress (1.0 - (q * 1.0) / nLemmas, wallTime () - wall, 0);
+
+    long ad = S->proof[P.steps[q]];
+    if (status == FAILED) {
+      printf ("c failed at proof line %li (modulo deletion errors)\n", P.steps[q] + 1);
+      failed = 1; P.abort = 1; break; }
+    if (status == SUCCESS) {
+      commitLemma (S, S->DB + (ad >> INFOBITS), R, marked);
+      S->optproof[S->nOpt++] = ad; }
+    vector<long>().swap (R->deps); vector<long>().swap (R->marks);
+    P.committed.store (q + 1, std::memory_order_release);
+
+    long passed = 0;
+    for (struct checker *C : checkers) passed = std::max (passed, C->passed.load (std::memory_order_acquire));
+    for (; written <= q && P.steps[written] > passed; written++) {
+      R = P.results + written;
+      if (R->status == SUCCESS) writeLemma (S->DB + (S->proof[P.steps[written]] >> INFOBITS), R->lits, R->pivot);
+      vector<int>().swap (R->lits); } }
+  if (S->bar) printProgress (0.0, wallTime () - wall, 1);
+
+  double busy = 0;
+  for (struct checker *C : checkers) {
+    C->thread.join ();
+    busy += C->busy;
+    S->nRemoved  += C->S.nRemoved  - nRemoved;
+    S->RATcount  += C->S.RATcount  - RATcount;
+    S->nResolve  += C->S.nResolve  - nResolve;
+    freeClone (&C->S);
+    delete C; }
+  for (; written < q; written++)
+    if (P.results[written].status == SUCCESS)
+      writeLemma (S->DB + (S->proof[P.steps[written]] >> INFOBITS), P.results[written].lits, P.results[written].pivot);
+  for (s = 0; s < S->nClauses; s++) {
+    int *clause = S->DB + (S->formula[s] >> INFOBITS);
+    if (marked[clauseID (clause)]) clause[ID] |= ACTIVE; }
+  for (s = 0; s < S->nStep; s++) {
+    int *clause = S->DB + (S->proof[s] >> INFOBITS);
+    if (S->proof[s] && !(S->proof[s] & 1) && marked[clauseID (clause)]) clause[ID] |= ACTIVE; }
+  wall = wallTime () - wall;
+  printf ("c backward checking took %.3f seconds on %i threads, which were busy for %.3f seconds (%.2fx)\n",
+          wall, nThreads, busy, wall > 0 ? busy / wall : 0.0);
+
+  delete [] P.results;
+  delete [] P.log;
+  delete [] P.active;
+  free (P.steps);
+  return failed ? FAILED : SUCCESS; }
+
+#ifdef HAVE_FORK
+// The state that the shards of backwardShards() share.  active holds the ACTIVE flags
+// by clause ID, and log the offsets of the clauses in the order in which they got
+// marked, as in struct backward
+struct shared { std::atomic<long> next, committed, logSize; std::atomic<int> abort;
+                std::atomic<int> *status, *active; std::atomic<long> *log;
+                long *nRemoved, *RATcount, *nResolve; double *busy; };
+
+static void *sharedMemory (size_t bytes) {
+  void *map = mmap (NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED) { printf ("c MEMOUT: allocation of shared memory failed\n"); exit (0); }
+  return map; }
+
+static void writeResult (FILE *file, long q, int status, struct lemmaResult *R) {
+  long n[3] = { (long) R->lits.size (), (long) R->deps.size (), (long) R->marks.size () };
+  fwrite (&q, sizeof (long), 1, file);
+  fwrite (&status, sizeof (int), 1, file);
+  fwrite (&R->pivot, sizeof (int), 1, file);
+  fwrite (&R->RATflag, sizeof (int), 1, file);
+  fwrite (n, sizeof (long), 3, file);
+  if (n[0]) fwrite (R->lits.data (),  sizeof (int),  n[0], file);
+  if (n[1]) fwrite (R->deps.data (),  sizeof (long), n[1], file);
+  if (n[2]) fwrite (R->marks.data (), sizeof (long), n[2], file); }
+
+static int readResult (FILE *file, struct lemmaResult *results) {
+  long q, n[3];
+  int status;
+  if (fread (&q, sizeof (long), 1, file) != 1) return 0;
+  struct lemmaResult *R = results + q;
+  if (fread (&status, sizeof (int), 1, file) != 1 || fread (&R->pivot, sizeof (int), 1, file) != 1 ||
+      fread (&R->RATflag, sizeof (int), 1, file) != 1 || fread (n, sizeof (long), 3, file) != 3) return 0;
+  R->lits.resize (n[0]); R->deps.resize (n[1]); R->marks.resize (n[2]);
+  if ((n[0] && fread (R->lits.data (),  sizeof (int),  n[0], file) != (size_t) n[0]) ||
+      (n[1] && fread (R->deps.data (),  sizeof (long), n[1], file) != (size_t) n[1]) ||
+      (n[2] && fread (R->marks.data (), sizeof (long), n[2], file) != (size_t) n[2])) return 0;
+  R->status = status;
+  return 1; }
+
+// The loop of a shard, which is checkLemmas() for a process: S is its copy-on-write
+// copy of the solver, the marks are shared through Q and the results are written to
+// file, because the parent only commits them once all shards are done
+static void checkShard (struct solver *S, struct shared *Q, long *steps, long nLemmas, int step, int k, FILE *file) {
+  double start = wallTime (), waiting = 0;
+  long q, pos = step, seen = 0;
+  long nRemoved = S->nRemoved, RATcount = S->RATcount, nResolve = S->nResolve;
+  struct lemmaResult R;
+  while (!Q->abort && (q = Q->next++) < nLemmas) {
+    long ad = S->proof[steps[q]];
+    int size = 0;
+    for (; pos >= steps[q]; pos--)
+      if (S->proof[pos]) size = retractStep (S, S->proof[pos]);
+
+    int *clause = S->DB + (ad >> INFOBITS);
+    int active;
+    double wait = wallTime ();
+    for (;;) {
+      long committed = Q->committed.load (std::memory_order_acquire);
+      active = Q->active[clauseID (clause)].load (std::memory_order_acquire);
+      if (active || committed >= q || Q->abort) break;
+      std::this_thread::yield (); }
+    waiting += wallTime () - wait;
+    if (!active) { Q->status[q].store (SKIPPED, std::memory_order_release); continue; }
+
+    for (; seen < Q->logSize.load (std::memory_order_acquire); seen++) {
+      long offset = Q->log[seen].load (std::memory_order_acquire);
+      if (offset == 0) break; // not written yet
+      adoptMark (S, offset); }
+    clause[ID] |= ACTIVE;
+    S->time = clauseTime (clause);
+    R.marks.clear (); R.deps.clear ();
+    S->result = &R;
+    int status = checkLemma (S, clause, size);
+    S->result = NULL;
+    R.pivot = clause[PIVOT];
+    for (size = 0; clause[size]; size++);
+    R.lits.assign (clause, clause + size);
+    for (long offset : R.marks)
+      if (!Q->active[clauseID (S->DB + offset)].exchange (1, std::memory_order_acq_rel))
+        Q->log[ Q->logSize++ ].store (offset, std::memory_order_release);
+    writeResult (file, q, status, &R);
+    Q->status[q].store (status, std::memory_order_release);
+    if (status == FAILED) { Q->abort = 1; break; } } // the trail of the lemma is still on S
+  fflush (file);
+  Q->nRemoved[k] = S->nRemoved - nRemoved;
+  Q->RATcount[k] = S->RATcount - RATcount;
+  Q->nResolve[k] = S->nResolve - nResolve;
+  Q->busy[k] = wallTime () - start - waiting; }
+
+static void reapShard (pid_t pid, std::atomic<int> *alive) {
+  waitpid (pid, NULL, 0);
+  (*alive)--; }
+
+// The backward pass of verify() from the conflict at step on S->shards forked
+// processes.  The shards share their marks as the threads of backwardParallel() do.
+// The parent only keeps track of the order in which lemmas may be skipped, and commits
+// the results from the files of the shards in proof order when they are done
+static int backwardShards (struct solver *S, int step) {
+  int k, nShards = S->shards;
+  long q, s, nLemmas = 0;
+
+  long *steps = (long *) malloc (sizeof (long) * (step + 1));
+  for (s = step; s >= 0; s--)
+    if (S->proof[s] && !(S->proof[s] & 1)) steps[nLemmas++] = s;
+
+  struct shared *Q = (struct shared *) sharedMemory (sizeof (struct shared));
+  Q->next = 0; Q->committed = 0; Q->logSize = 0; Q->abort = 0;
+  Q->status = (std::atomic<int> *) sharedMemory (sizeof (std::atomic<int>) * (nLemmas + 1));
+  Q->active = (std::atomic<int> *) sharedMemory (sizeof (std::atomic<int>) * (S->count + 1));
+  Q->log = (std::atomic<long> *) sharedMemory (sizeof (std::atomic<long>) * (S->count + 1));
+  Q->nRemoved = (long *) sharedMemory (sizeof (long) * 3 * nShards + sizeof (double) * nShards);
+  Q->RATcount = Q->nRemoved + nShards;
+  Q->nResolve = Q->RATcount + nShards;
+  Q->busy = (double *) (Q->nResolve + nShards);
+
+  vector<char> marked (S->count + 1, 0);
+  for (s = 0; s < S->nClauses; s++) {
+    int *clause = S->DB + (S->formula[s] >> INFOBITS);
+    marked[clauseID (clause)] = clause[ID] & ACTIVE; }
+  for (s = 0; s < S->nStep; s++) {
+    int *clause = S->DB + (S->proof[s] >> INFOBITS);
+    if (S->proof[s] && !(S->proof[s] & 1)) marked[clauseID (clause)] = clause[ID] & ACTIVE; }
+  for (s = 0; s <= S->count; s++) Q->active[s] = marked[s];
+
+  vector<FILE *> files;
+  vector<pid_t> pids;
+  double wall = wallTime (), offset = cpuTime () - wall;
+  fflush (stdout);
+  for (k = 0; k < nShards; k++) {
+    FILE *file = tmpfile ();
+    if (file == NULL) { printf ("c ERROR: could not create a temporary file for shard %i\n", k); exit (0); }
+    pid_t pid = fork ();
+    if (pid < 0) { printf ("c ERROR: could not fork shard %i\n", k); exit (0); }
+    if (pid == 0) {
+      checkShard (S, Q, steps, nLemmas, step, k, file);
+      fflush (stdout); // warnings; _exit () skips the other buffers of the parent
+      _exit (0); }
+    files.push_back (file); pids.push_back (pid); }
+
+  // A reaper per shard waits for its own process, so that the loop below notices
+  // when all shards are gone without reaping other children
+  std::atomic<int> alive (nShards);
+  vector<std::thread> reapers;
+  for (pid_t pid : pids)
+    reapers.push_back (std::thread (reapShard, pid, &alive));
+
+  int failed = 0;
+  for (q = 0; q < nLemmas; q++) {
+    int status;
+    while ((status = Q->status[q].load (std::memory_order_acquire)) == 0) {
+      int seconds = (int) (wallTime () + offset) - S->start_time;
+      if ((seconds > S->timeout) && (S->optimize == 0)) printf ("s TIMEOUT\n"), exit (0);
+      if (alive == 0 && Q->status[q].load (std::memory_order_acquire) == 0) {
+        printf ("c ERROR: shards stopped before all lemmas were checked\n"); exit (0); }
+      std::this_thread::yield (); }
+
+    if (S->bar && (q % 1000) == 0)
+      printProgress (1.0 - (q * 1.0) / nLemmas, wallTime () - wall, 0);
+
+    if (status == FAILED) {
+      printf ("c failed at proof line %li (modulo deletion errors)\n", steps[q] + 1);
+      failed = 1; Q->abort = 1; break; }
+    Q->committed.store (q + 1, std::memory_order_release); }
+  if (S->bar) printProgress (0.0, wallTime () - wall, 1);
+  for (std::thread &reaper : reapers) reaper.join ();
+
+  double busy = 0;
+  struct lemmaResult *results = new lemmaResult[nLemmas];
+  for (q = 0; q < nLemmas; q++) results[q].status = 0;
+  for (k = 0; k < nShards; k++) {
+    busy += Q->busy[k];
+    S->nRemoved += Q->nRemoved[k];
+    S->RATcount += Q->RATcount[k];
+    S->nResolve += Q->nResolve[k];
+    rewind (files[k]);
+    while (readResult (files[k], results));
+    fclose (files[k]); }
+  for (s = 0; s < S->nClauses; s++) {
+    int *clause = S->DB + (S->formula[s] >> INFOBITS);
+    if (Q->active[clauseID (clause)]) clause[ID] |= ACTIVE; }
+  for (s = 0; s < S->nStep; s++) {
+    int *clause = S->DB + (S->proof[s] >> INFOBITS);
+    if (S->proof[s] && !(S->proof[s] & 1) && Q->active[clauseID (clause)]) clause[ID] |= ACTIVE; }
+
+  for (q = 0; !failed && q < nLemmas; q++) {
+    struct lemmaResult *R = results + q;
+    long ad = S->proof[steps[q]];
+    if (R->status == SUCCESS) { // the shards are gone, so the lemma can be written back at once
+      commitLemma (S, S->DB + (ad >> INFOBITS), R, marked);
+      writeLemma (S->DB + (ad >> INFOBITS), R->lits, R->pivot);
+      S->optproof[S->nOpt++] = ad; }
+    vector<int>().swap (R->lits); vector<long>().swap (R->deps); vector<long>().swap (R->marks); }
+  wall = wallTime () - wall;
+  printf ("c backward checking took %.3f seconds in %i shards, which were busy for %.3f seconds (%.2fx)\n",
+          wall, nShards, busy, wall > 0 ? busy / wall : 0.0);
+
+  delete [] results;
+  munmap (Q->status, sizeof (std::atomic<int>) * (nLemmas + 1));
+  munmap (Q->active, sizeof (std::atomic<int>) * (S->count + 1));
+  munmap (Q->log, sizeof (std::atomic<long>) * (S->count + 1));
+  munmap (Q->nRemoved, sizeof (long) * 3 * nShards + sizeof (double) * nShards);
+  munmap (Q, sizeof (struct shared));
+  free (steps);
+  return failed ? FAILED : SUCCESS; }
+#endif
+
+// Starts S->checkThreads threads that check the lemmas of the forward pass while
+// verify() applies the proof steps and hands out the lemmas.  All threads share S->DB,
+// so from here on S keeps its watched literals in a view as well
+static void checkWindows (struct checker *C);
+
+static struct forward *startForward (struct solver *S) {
+  int t;
+  long step, n = 0;
+  struct forward *F = new forward;
+  for (step = 0; step < S->nStep; step++)
+    if ((S->proof[step] & 1) == 0) n++;
+  F->S = S; F->nLemmas = 0; F->next = 0; F->done = 0; F->abort = 0;
+  F->steps = (long *) malloc (sizeof (long) * (n + 1));
+  if (F->steps == NULL) { printf ("c MEMOUT: allocation of forward lemmas failed\n"); exit (0); }
+  F->results = new lemmaResult[n + 1];
+  for (step = 0; step <= n; step++) F->results[step].status = 0;
+  F->window = n / (64 * S->checkThreads) + 1;
+  F->nRemoved = S->nRemoved; F->RATcount = S->RATcount; F->nResolve = S->nResolve;
+  F->start = wallTime ();
+  S->view = newView (S);
+  for (t = 0; t < S->checkThreads; t++) {
+    struct checker *C = new checker;
+    cloneSolver (&C->S, S);
+    C->P = NULL; C->F = F; C->pos = 0; C->seen = 0; C->busy = 0;
+    F->checkers.push_back (C); }
+  for (struct checker *C : F->checkers) C->thread = std::thread (checkWindows, C);
+  return F; }
+
+// Applies proof step to a checker thread as the forward pass of verify() does, and
+// checks the lemma first if R is set
+static void forwardStep (struct solver *S, long step, struct lemmaResult *R) {
+  long ad = S->proof[step];
+  if (ad == 0) return; // ignored deletion
+  int *lemmas = S->DB + (ad >> INFOBITS);
+
+  if (ad & 1) {
+    removeWatch (S, lemmas, 0), removeWatch (S, lemmas, 1); removeOccurs (S, lemmas);
+    return; }
+  if (!lemmas[1]) addUnit (S, (long) (lemmas - S->DB));
+
+  int size = watchSize (S, lemmas);
+  if (size < 0) {
+    if (R) R->status.store (SUCCESS, std::memory_order_release);
+    return; }
+  if (R) {
+    int *copy = copyLemma (S, lemmas);
+    S->time = clauseTime (copy);
+    S->result = R;
+    int status = redundancyCheck (S, copy, sortSize (S, copy), 1);
+    S->result = NULL;
+    R->pivot = copy[PIVOT];
+    R->status.store (status, std::memory_order_release);
+    size = watchSize (S, lemmas);
+    S->nDependencies = 0; }
+
+  if (lemmas[1])
+    addWatch (S, lemmas, 0), addWatch (S, lemmas, 1), addOccurs (S, lemmas);
+  if (size == 1) {
+    int lit = watched (S, lemmas)[0];
+    assign (S, lit); S->reason[abs (lit)] = ((long) ((lemmas)-S->DB)) + 1;
+    if (propagate (S, 1, 1, getConflictNo (S, lemmas), NULL) == UNSAT) return;
+    S->forced = S->processed; } }
+
+// A checker thread claims the next window of lemmas and replays the proof up to each
+// of them, waiting for verify() to get there.  It stops at its first failure, since
+// all later lemmas are irrelevant then
+static void checkWindows (struct checker *C) {
+  struct solver *S = &C->S;
+  struct forward *F = C->F;
+  double busy = 0;
+  long q, w;
+  while (!F->abort) {
+    w = F->next++ * F->window;
+    for (q = w; q < w + F->window && !F->abort; q++) {
+      while (q >= F->nLemmas && !F->done) std::this_thread::yield ();
+      if (q >= F->nLemmas) break;
+      double start = wallTime ();
+      for (; C->pos < F->steps[q]; C->pos++) forwardStep (S, C->pos, NULL);
+      forwardStep (S, C->pos++, F->results + q);
+      busy += wallTime () - start;
+      if (F->results[q].status == FAILED) break; }
+    if (q < w + F->window) break; }
+  C->busy = busy; }
+
+// Commits the lemmas checked by the threads of startForward() and frees F.  The marks
+// and dependencies of the lemmas are committed in proof order, so a failure is
+// reported at the same proof line as in the sequential pass.  The dependencies of the
+// final conflict, found by verify(), are kept
+static int forwardParallel (struct forward *F) {
+  struct solver *S = F->S;
+  int failed = 0, nThreads = F->checkers.size ();
+  long q, nLemmas = F->nLemmas;
+  vector<long> conflict (S->dependencies, S->dependencies + S->nDependencies);
+  F->done = 1;
+
+  for (q = 0; q < nLemmas; q++) {
+    struct lemmaResult *R = F->results + q;
+    int status;
+    while ((status = R->status.load (std::memory_order_acquire)) == 0) std::this_thread::yield ();
+    if (status == FAILED) {
+      printf ("c failed at proof line %li (modulo deletion errors)\n", F->steps[q] + 1);
+      failed = 1; F->abort = 1; break; }
+
+    int *clause = S->DB + (S->proof[F->steps[q]] >> INFOBITS);
+    for (long offset : R->marks) // only the flags, as S is past the deletion of some of them
+      if (!isActive (S, S->DB + offset)) { setActive (S, S->DB + offset); S->nActive++; }
+    clause[PIVOT] = R->pivot;
+    S->time = clauseTime (clause);
+    setDependencies (S, R->deps);
+    printDependencies (S, clause, R->RATflag);
+    vector<long>().swap (R->deps); vector<long>().swap (R->marks); }
+
+  double busy = 0;
+  for (struct checker *C : F->checkers) {
+    C->thread.join ();
+    busy += C->busy;
+    S->nRemoved  += C->S.nRemoved  - F->nRemoved;
+    S->RATcount  += C->S.RATcount  - F->RATcount;
+    S->nResolve  += C->S.nResolve  - F->nResolve;
+    freeClone (&C->S);
+    delete C; }
+  double wall = wallTime () - F->start;
+  printf ("c forward checking took %.3f seconds on %i threads, which were busy for %.3f seconds (%.2fx)\n",
+          wall, nThreads, busy, wall > 0 ? busy / wall : 0.0);
+
+  // back to the watched literals in S->DB, as the rest of verify () expects them there
+  long s;
+  for (s = 0; s < S->nClauses + S->nStep; s++) {
+    long ad = s < S->nClauses ? S->formula[s] : S->proof[s - S->nClauses];
+    if (ad == 0 || (ad & 1)) continue;
+    int *clause = S->DB + (ad >> INFOBITS);
+    if (S->view[clauseID (clause)].active) clause[ID] |= ACTIVE; }
+  free (S->view); S->view = NULL;
+
+  setDependencies (S, conflict);
+  free (F->steps);
+  delete [] F->results;
+  delete F;
+  return failed ? FAILED : SUCCESS; }
+
+// A RAT helper follows the backward pass over S->DB like a checker thread, but only
+// catches up when a RAT check needs it.  top is the end of the top-level units on its
+// trail
+struct ratHelper { struct solver S; long pos, seen; int *top; std::thread thread; };
+
+// The propagations of one split RAT check.  Job j handles candidate RATset[jobs[j]]
+// after the first clears[j] entries of cleared lost their reason
+struct ratRound { struct solver *M; int pivot, mark, nHelpers; long nJobs;
+                  int *jobs, *clears, *cleared; struct lemmaResult *results; };
+
+// A lemma that the backward pass checked while the helpers were behind it.  Its
+// checked literals are written to S->DB after the next round, as the helpers still
+// have to retract the lemma as it was added
+struct heldLemma { long step; int pivot; vector<int> lits; };
+
+// The RAT helpers wait on wake until splitRAT () starts the next round, and the last
+// one to finish the round signals done.  The main thread waits meanwhile, so S->DB
+// does not change while the helpers read it
+struct ratPool { vector<struct ratHelper*> helpers; vector<struct heldLemma> held;
+                 std::mutex lock; std::condition_variable wake, done;
+                 struct ratRound *round; long rounds; int running, stop; };
+
+static void checkCandidates (struct ratHelper *H, struct ratRound *Q, int h);
+
+static void runHelper (struct ratPool *P, int h) {
+  long seen = 0;
+  std::unique_lock<std::mutex> guard (P->lock);
+  for (;;) {
+    while (!P->stop && P->rounds == seen) P->wake.wait (guard);
+    if (P->stop) return;
+    seen = P->rounds;
+    guard.unlock ();
+    checkCandidates (P->helpers[h], P->round, h);
+    guard.lock ();
+    if (--P->running == 0) P->done.notify_one (); } }
+
+// Writes back the held lemmas that all helpers have passed, i.e., all of them after a
+// round or with all set
+static void releaseLemmas (struct solver *S, int all) {
+  struct ratPool *P = S->helpers;
+  long pos = P->helpers[0]->pos;
+  size_t i, j = 0;
+  for (i = 0; i < P->held.size (); i++) {
+    struct heldLemma *L = &P->held[i];
+    if (all || L->step > pos) writeLemma (S->DB + (S->proof[L->step] >> INFOBITS), L->lits, L->pivot);
+    else P->held[j++] = std::move (*L); }
+  P->held.resize (j); }
+
+// Keeps the literals of a lemma that the backward pass checked on a copy
+static void holdLemma (struct solver *S, long step, int *lemma) {
+  int size = 0;
+  while (lemma[size]) size++;
+  S->helpers->held.push_back ({ step, lemma[PIVOT], vector<int> (lemma, lemma + size) }); }
+
+static void freeHelpers (struct solver *S) {
+  struct ratPool *P = S->helpers;
+  if (P == NULL) return;
+  releaseLemmas (S, 1);
+  { std::lock_guard<std::mutex> guard (P->lock); P->stop = 1; }
+  P->wake.notify_all ();
+  for (struct ratHelper *H : P->helpers) { H->thread.join (); freeClone (&H->S); delete H; }
+  delete P; delete S->markLog;
+  S->helpers = NULL; S->markLog = NULL; }
+
+// Starts the helpers in the middle of a RAT check, without the assignments of the lemma
+static void startHelpers (struct solver *S) {
+  int t;
+  struct ratPool *P = new ratPool;
+  P->round = NULL; P->rounds = 0; P->running = 0; P->stop = 0;
+  S->helpers = P;
+  S->markLog = new vector<long>;
+  for (t = 0; t < S->ratThreads; t++) {
+    struct ratHelper *H = new ratHelper;
+    cloneSolver (&H->S, S);
+    H->pos = S->backStep - 1; H->seen = 0;
+    H->top = H->S.falseStack + (S->topLevel - S->falseStack);
+    P->helpers.push_back (H); }
+  for (t = 0; t < S->ratThreads; t++) P->helpers[t]->thread = std::thread (runHelper, P, t); }
+
+// Brings H to the state of M at the start of the current RAT check: it walks to the
+// proof position of M, takes over its marks and cleared reasons, and assigns the
+// literals of the lemma check, propagating them again for its own watches
+static void syncHelper (struct ratHelper *H, struct solver *M) {
+  struct solver *S = &H->S;
+  int *lit;
+  while (S->assigned > H->top) {
+    int l = *(--S->assigned);
+    S->falsified[l] = 0; S->reason[abs (l)] = 0; }
+  S->forced = S->processed = S->assigned;
+  for (; H->pos >= M->backStep; H->pos--)
+    if (S->proof[H->pos]) retractStep (S, S->proof[H->pos]);
+  H->top = S->assigned;
+  assert (H->top - S->falseStack == M->topLevel - M->falseStack);
+  for (; H->seen < (long) M->markLog->size (); H->seen++) adoptMark (S, (*M->markLog)[H->seen]);
+
+  for (lit = M->falseStack; lit < M->topLevel; lit++) S->reason[abs (*lit)] = M->reason[abs (*lit)];
+  for (; lit < M->assigned; lit++) {
+    S->falsified[*lit] = M->falsified[*lit];
+    S->reason[abs (*lit)] = M->reason[abs (*lit)];
+    *(S->assigned++) = *lit; }
+  S->prep = M->prep; S->RATmode = 1;
+  if (propagate (S, 0, 0, -1, NULL) == UNSAT) assert (0); // the lemma was already propagated
+  S->forced = S->processed = S->assigned; }
+
+// Runs the jobs h, h + nHelpers, ... of round Q on helper h, as the sequential loop of
+// checkRAT() does for a candidate that is not blocked.  It stops at its first failure,
+// since the check fails there anyway
+static void checkCandidates (struct ratHelper *H, struct ratRound *Q, int h) {
+  struct solver *S = &H->S, *M = Q->M;
+  long j; int applied = 0;
+  syncHelper (H, M);
+  for (j = h; j < Q->nJobs; j += Q->nHelpers) {
+    struct lemmaResult *R = Q->results + j;
+    while (applied < Q->clears[j]) S->reason[abs (Q->cleared[applied++])] = 0;
+    int *RATcls = M->DB + M->RATset[Q->jobs[j]];
+    while (*RATcls) {
+      int lit = *RATcls++;
+      if (lit != -Q->pivot && !S->falsified[lit]) {
+        assign (S, -lit); S->reason[abs (lit)] = 0; } }
+    S->nDependencies = 0;
+    S->result = R;
+    int res = propagate (S, 0, Q->mark, -1, NULL);
+    S->result = NULL;
+    if (res == SAT) {
+      while (S->forced < S->assigned) {
+        S->falsified[*(--S->assigned)] = 0;
+        S->reason[abs (*S->assigned)] = 0; }
+      R->status = FAILED; break; }
+    R->deps.assign (S->dependencies, S->dependencies + S->nDependencies);
+    R->status = SUCCESS; } }
+
+// The candidate loop of checkRAT() with the propagations split over the RAT helpers.
+// Which candidates are blocked, and whose reasons their analysis clears, is worked out
+// here first.  The marks and dependencies are then merged in candidate order, so the
+// dependency list has the same layout as in the sequential loop
+static int splitRAT (struct solver *S, int pivot, int mark, int nRAT) {
+  int i, flag = 1;
+  vector<int> block (nRAT, 0), jobs, clears, cleared;
+  vector<long> why (nRAT, 0);
+
+  for (i = nRAT - 1; i >= 0; i--) {
+    int* RATcls = S->DB + S->RATset[i];
+    while (*RATcls) {
+      int lit = *RATcls++;
+      if (lit != -pivot && S->falsified[-lit])
+        if (!block[i] || why[i] > S->reason[abs (lit)])
+          block[i] = lit, why[i] = S->reason[abs (lit)]; }
+    if (block[i] && why[i]) { cleared.push_back (block[i]); S->reason[abs (block[i])] = 0; }
+    if (!block[i]) { jobs.push_back (i); clears.push_back (cleared.size ()); } }
+  for (i = nRAT - 1; i >= 0; i--)
+    if (block[i] && why[i]) S->reason[abs (block[i])] = why[i];
+
+  if (S->helpers == NULL) startHelpers (S);
+  struct ratPool *P = S->helpers;
+  struct ratRound Q;
+  Q.M = S; Q.pivot = pivot; Q.mark = mark; Q.nHelpers = P->helpers.size ();
+  Q.nJobs = jobs.size (); Q.jobs = jobs.data (); Q.clears = clears.data (); Q.cleared = cleared.data ();
+  Q.results = new lemmaResult[Q.nJobs];
+  for (i = 0; i < Q.nJobs; i++) Q.results[i].status = 0;
+  { std::lock_guard<std::mutex> guard (P->lock);
+    P->round = &Q; P->running = Q.nHelpers; P->rounds++; }
+  P->wake.notify_all ();
+  { std::unique_lock<std::mutex> guard (P->lock);
+    while (P->running) P->done.wait (guard); }
+  releaseLemmas (S, 0);
+  S->ratSplits++;
+
+  long j = 0;
+  for (i = nRAT - 1; i >= 0; i--) {
+    int* RATcls = S->DB + S->RATset[i];
+    long id = clauseID (RATcls);
+    if (S->verb) {
+      printf ("c RAT clause: "); printClause (RATcls, S); }
+    if (block[i] && why[i]) {
+      analyze (S, S->DB + why[i], -1, -1, NULL);
+      S->reason[abs (block[i])] = 0; }
+    if (!block[i]) {
+      struct lemmaResult *R = Q.results + j++;
+      if (R->status != SUCCESS) { flag = 0; break; }
+      for (long offset : R->marks) {
+        S->nResolve++;
+        if ((S->DB[offset + ID] & ACTIVE) == 0) activateClause (S, S->DB + offset, 0); }
+      for (long dep : R->deps) addDependency (S, dep >> 1, dep & 1); }
+    addDependency (S, -id, 1); }
+
+  delete [] Q.results;
+  return flag; }
+
+// The hints of an LRAT line make the clauses they refer to part of the core.  With
+// del set, a clause that joins the core gets its deletion in the optimized proof here,
+// which is after its last use in forward order.  Returns whether line is a RAT step
+static int useHints (struct solver *S, int *line, vector<long> &offset, vector<char> &used, int del) {
+  int RAT = 0;
+  while (*line) lratNext (&line);
+  for (line++; *line; ) {
+    long id = lratNext (&line);
+    if (id < 0) RAT = 1, id = -id;
+    if (used[id]) continue;
+    used[id] = 1;
+    int *clause = S->DB + offset[id];
+    clause[ID] |= ACTIVE; S->nActive++;
+    if (del && clause[1]) S->optproof[S->nOpt++] = (offset[id] << INFOBITS) + 1; }
+  return RAT; }
+
+// Works out the core of a forward check from the LRAT lines of the lemmas: a clause is
+// in the core if the final conflict depends on it, where RAT candidates count as well.
+// The optimized proof is built in the order of the backward pass, from the conflict
+// back, so that printProof () can treat it the same way
+static void forwardCore (struct solver *S) {
+  vector<long> offset (S->count + 1, 0);
+  vector<char> used (S->count + 1, 0);
+  long s;
+  for (s = 0; s < S->nClauses; s++) {
+    int *clause = S->DB + (S->formula[s] >> INFOBITS);
+    offset[clauseID (clause)] = clause - S->DB;
+    clause[ID] &= ~ACTIVE; }
+  for (s = 0; s < S->nStep; s++) {
+    int *clause = S->DB + (S->proof[s] >> INFOBITS);
+    if (S->proof[s] && !(S->proof[s] & 1)) {
+      offset[clauseID (clause)] = clause - S->DB;
+      clause[ID] &= ~ACTIVE; } }
+
+  S->nActive = 0; S->RATcount = 0; S->nOpt = 0;
+  mapLRAT (S);
+  useHints (S, lratLine (S, S->count), offset, used, 0);
+  for (s = S->nStep - 1; s >= 0; s--) {
+    long ad = S->proof[s];
+    if (ad == 0 || (ad & 1)) continue;
+    long id = clauseID (S->DB + (ad >> INFOBITS));
+    if (!used[id]) continue;
+    if (useHints (S, lratLine (S, id), offset, used, 1)) S->RATcount++;
+    S->optproof[S->nOpt++] = ad; }
+  unmapLRAT (S); }
+
+// The backward pass has passed all lemmas behind the clause at offset, the one of proof
+// step step, so that part of S->DB only matters for the output.  Once it is an eighth of
+// the database, its core lemmas are moved down in place behind the clause (without their
+// literals beyond the second when only -L needs them), the optimized proof is pointed to
+// them, the stale watches of the part are cut from the lists and the rest is given back.
+// The kept lemmas of earlier cuts, at S->kept->base and up, are moved along
+#define SHRINKMIN  (1 << 20)
+static void shrinkDB (struct solver *S, long offset, long step) {
+  struct keptLemmas *K = S->kept;
+  int *clause = S->DB + offset;
+  while (*clause) clause++;
+  long end = clause + 1 - S->DB, dead = K->base - end;
+  if (dead < SHRINKMIN || 8 * dead < S->mem_used) return;
+
+  vector<long> from, to;
+  long s, next = end;
+  for (s = step + 1; s < K->step; s++) {
+    long ad = S->proof[s];
+    if (ad == 0 || (ad & 1)) continue;
+    int *lemma = S->DB + (ad >> INFOBITS);
+    if (!K->copy || (lemma[ID] & ACTIVE) == 0) continue;
+    int size = 0, header = EXTRA - 1 + (lemma[ID] < 0);
+    while (lemma[size]) size++;
+    if (!K->literals && size > 2) size = 2;
+    from.push_back (ad >> INFOBITS);
+    to.push_back (next + header);
+    memmove (S->DB + next, lemma - header, sizeof (int) * (header + size));
+    next += header + size;
+    S->DB[next++] = 0; }
+  long kept = S->mem_used - K->base;
+  memmove (S->DB + next, S->DB + K->base, sizeof (int) * kept);
+  long shift = K->base - next;
+
+  long i;
+  for (i = 0; i < S->nOpt; i++) {
+    long ad = S->optproof[i] >> INFOBITS;
+    if (ad < end) continue;
+    if (ad >= K->base) ad -= shift;
+    else {
+      long k = std::lower_bound (from.begin (), from.end (), ad) - from.begin ();
+      assert (k < (long) from.size () && from[k] == ad);
+      ad = to[k]; }
+    S->optproof[i] = (ad << INFOBITS) | (S->optproof[i] & ((1 << INFOBITS) - 1)); }
+  K->step = step + 1;
+  K->base = end;
+
+  int j;
+  for (j = -S->maxVar; j <= S->maxVar; j++)
+    if (j) { cutWatches (S, S->wlist + j, end); cutWatches (S, S->blist + j, end); }
+  K->released += S->mem_used - (next + kept);
+  S->mem_used = next + kept;
+  S->DB = (int *) realloc (S->DB, sizeof (int) * S->mem_used);
+  if (S->DB == NULL) { printf ("c MEMOUT: reallocation of clause database failed\n"); exit (0); } }
+
+static int streamProof (struct solver *S);
+
 int verify (struct solver *S, int begin, int end) {
   if (init (S) == UNSAT) return UNSAT;
+  if (S->stream) return streamProof (S);
 
+  struct forward *F = NULL;
   if (S->mode == FORWARD_UNSAT) {
     if (begin == end)
-      printf ("c start forward verification\n"); }
+      printf ("c start forward verification\n");
+    if (S->checkThreads && !S->cl_ids && !S->cl_used_file && !S->anc_cl_used_file)
+      F = startForward (S); }
 
   int step;
   int adds = 0;
@@ -1179,7 +3016,7 @@ int verify (struct solver *S, int begin, int end) {
 
     //This is the new clause now.
     int *lemmas = S->DB + (ad >> INFOBITS);
-    S->time = lemmas[ID];
+    S->time = clauseTime (lemmas);
 
     if (d) { active--; }
     else   { active++; adds++; }
@@ -1210,21 +3047,21 @@ int verify (struct solver *S, int begin, int end) {
         else { addUnit (S, (long) (lemmas - S->DB)); } } }
 
     if (d && lemmas[1]) { // if delete and not unit
-      if ((S->reason[abs (lemmas[0])] - 1) == (lemmas - S->DB)) { // what is this check?
+      if ((S->reason[abs (watched (S, lemmas)[0])] - 1) == (lemmas - S->DB)) { // what is this check?
         if (S->mode != FORWARD_SAT) { // ignore pseudo unit clause deletion
           if (S->verb) { printf ("c ignoring deletion intruction %07li: ", (lemmas - S->DB));
             printClause (lemmas, S); }
 //        if (S->mode == BACKWARD_UNSAT) { // ignore pseudo unit clause deletion
           S->proof[step] = 0; }
         else { // if (S->mode == FORWARD_SAT) { // also for FORWARD_UNSAT?
-          removeWatch (S, lemmas, 0), removeWatch (S, lemmas, 1);
+          removeWatch (S, lemmas, 0), removeWatch (S, lemmas, 1); removeOccurs (S, lemmas);
           propagateUnits (S, 0); } }
       else {
-        removeWatch (S, lemmas, 0), removeWatch (S, lemmas, 1); }
+        removeWatch (S, lemmas, 0), removeWatch (S, lemmas, 1); removeOccurs (S, lemmas); }
       if (S->mode == FORWARD_UNSAT ) continue;   // Ignore deletion of top-level units
       if (S->mode == BACKWARD_UNSAT) continue; }
 
-    int size = sortSize (S, lemmas); // after removal of watches
+    int size = watchSize (S, lemmas); // after removal of watches
 
     if (d && S->mode == FORWARD_SAT) {
       if (size == -1) propagateUnits (S, 0);  // necessary?
@@ -1236,23 +3073,27 @@ int verify (struct solver *S, int begin, int end) {
     if (d == 0 && S->mode == FORWARD_UNSAT) {
       if (step > end) {
         if (size < 0) continue; // Fix of bus error: 10
-        if (redundancyCheck (S, lemmas, size, 1) == FAILED) {
+        if (F) { F->steps[F->nLemmas] = step; F->nLemmas++; }
+        else if (redundancyCheck (S, lemmas, size, 1) == FAILED) {
           printf ("c failed at proof line %i (modulo deletion errors)\n", step + 1);
           return SAT; }
 
-        size = sortSize (S, lemmas);
-        S->nDependencies = 0; } }
+        size = watchSize (S, lemmas);
+        S->nDependencies = 0; S->current = NULL; } }
 
     if (lemmas[1])
-      addWatch (S, lemmas, 0), addWatch (S, lemmas, 1);
+      addWatch (S, lemmas, 0), addWatch (S, lemmas, 1), addOccurs (S, lemmas);
 
-    if (size == 0) { printf ("c conflict claimed, but not detected\n"); return SAT; }  // change to FAILED?
+    if (size == 0) {
+      if (F && forwardParallel (F) == FAILED) return SAT;
+      printf ("c conflict claimed, but not detected\n"); return SAT; }  // change to FAILED?
     if (size == 1) {
-      if (S->verb) printf ("c found unit %i\n", lemmas[0]);
+      int lit = watched (S, lemmas)[0];
+      if (S->verb) printf ("c found unit %i\n", lit);
       //int64_t clause_id = get_clause_id(lemmas);
-      int64_t conflict_no = get_at(lemmas, CONFLICT_NO);
+      int64_t conflict_no = getConflictNo (S, lemmas);
       //printf("unit ID %d\n", clause_id);
-      assign (S, lemmas[0]); S->reason[abs (lemmas[0])] = ((long) ((lemmas)-S->DB)) + 1;
+      assign (S, lit); S->reason[abs (lit)] = ((long) ((lemmas)-S->DB)) + 1;
       if (propagate (S, 1, 1, conflict_no, NULL) == UNSAT) goto start_verification;
       S->forced = S->processed; } }
 
@@ -1260,6 +3101,7 @@ int verify (struct solver *S, int begin, int end) {
     postprocess (S); return UNSAT; }
 
   if (S->mode == FORWARD_UNSAT) {
+    if (F && forwardParallel (F) == FAILED) return SAT;
     if (begin == end) {
       postprocess (S);
       printf ("c ERROR: all lemmas verified, but no conflict\n"); }
@@ -1283,7 +3125,9 @@ int verify (struct solver *S, int begin, int end) {
   //////////////
   start_verification:;
   if (S->mode == FORWARD_UNSAT) {
+    if (F && forwardParallel (F) == FAILED) return SAT;
     printDependencies (S, NULL, 0);
+    if (keepLRATlines (S)) forwardCore (S);
     postprocess (S); return UNSAT; }
 
   if (!S->backforce)
@@ -1295,6 +3139,7 @@ int verify (struct solver *S, int begin, int end) {
 
   S->forced = S->processed;
   assert (S->mode == BACKWARD_UNSAT); // only reachable in BACKWARD_UNSAT mode
+  sweepAllWatches (S);  // clauses deleted in the forward pass are added again below
 
   S->nOpt = 0;
 
@@ -1302,6 +3147,20 @@ int verify (struct solver *S, int begin, int end) {
 
   double max = (double) adds;
 
+#ifdef HAVE_FORK
+  if (S->shards && !S->cl_ids && !S->cl_used_file && !S->anc_cl_used_file) {
+    if (backwardShards (S, step) == FAILED) return SAT;
+    postprocess (S); return UNSAT; }
+#endif
+  if (S->checkThreads && !S->cl_ids && !S->cl_used_file && !S->anc_cl_used_file) {
+    if (backwardParallel (S, step) == FAILED) return SAT;
+    postprocess (S); return UNSAT; }
+
+  if (S->shrink && !S->optimize && !S->ratThreads) {
+    S->kept = new keptLemmas ();
+    S->kept->step = step + 1; S->kept->base = S->mem_used; S->kept->released = 0;
+    S->kept->copy = S->lemmaStr || S->lratFile; S->kept->literals = S->lemmaStr != NULL; }
+
   double backward_time = cpuTime();
   for (; step >= 0; step--) {
     double current_time = cpuTime();
@@ -1309,77 +3168,42 @@ int verify (struct solver *S, int begin, int end) {
     if ((seconds > S->timeout) && (S->optimize == 0)) printf ("s TIMEOUT\n"), exit (0);
 
     if (S->bar)
-      if ((adds % 1000) == 0) {
-        int f;
-        double time = cpuTime()-backward_time;
-        double fraction = (adds * 1.0) / max;
-        printf("c %.2f%% [", 100.0 * (1.0 - fraction));
-        for (f = 1; f <= 20; f++) {
-          if ((1.0 - fraction) * 20.0 < 1.0 * f) printf(" ");
-          else printf("="); }
-        printf("] time remaining: %.2f seconds ", time / (1.0 - fraction) - time);
-        if (step == 0) printf("\n");
-        fflush (stdout); }
+      if ((adds % 1000) == 0)
+        printProgress ((adds * 1.0) / max, cpuTime()-backward_time, step == 0);
 
     long ad = S->proof[step]; long d = ad & 1;
+    if (ad && d == 0 && S->kept) shrinkDB (S, ad >> INFOBITS, step);
     int *clause = S->DB + (ad >> INFOBITS);
 
 
     if (ad == 0) continue; // Skip lemma that has been removed from proof
+    S->backStep = step;
 
-    //LSB bit of "S->proof[step]"
-    if ( d == 0) {
-      if (S->verb) {printf("d was zero for: "); printClause (clause, S);}
-      adds--;
-      if (clause[1]) {
-        removeWatch (S, clause, 0), removeWatch (S, clause, 1);
-        if (S->reason[abs (clause[0])] == (clause + 1 - S->DB)) {  // use this check also for units?
-          unassignUnit (S, clause[0]); } }
-      else unassignUnit (S, clause[0]); }
-
-    int size = sortSize (S, clause);
+    if (d == 0) adds--;
+    int size = retractStep (S, ad);
+    if (d) continue;
 
-    if (d) {
-      if (S->verb) { printf ("c adding clause (%i) ", size); printClause (clause, S); }
-      addWatch (S, clause, 0), addWatch (S, clause, 1); continue; }
-
-    S->time = clause[ID];
+    S->time = clauseTime (clause);
     if ((S->time & ACTIVE) == 0) {
       skipped++;
 //      if ((skipped % 100) == 0) printf("c skipped %i, checked %i\n", skipped, checked);
       if (S->verb) {printf("c Skipping: "); printClause (clause, S);}
       continue; } // If not marked, continue
 
-    assert (size >= 1);
-    int *_clause = clause + size;
-    while (*_clause++) { S->nRemoved++; }
-    clause[size] = 0;
-
-    if (S->verb) {
-      printf ("c validating clause (%i, %i):  ", clause[PIVOT], size); printClause (clause, S); }
-/*
-    int i;
-    if (size > 1 && (top_flag == 1)) {
-      int last = clause[size - 1];
-      int pivot = clause[PIVOT];
-      for (i = 0; i < size; i++) {
-        int tmp = clause[i];
-        clause[i] = last;
-        clause[size - 1] = 0;
-        if (tmp == pivot) clause[PIVOT] = clause[0];
-        if (redundancyCheck (S, clause, size - 1, 0) != FAILED) {
-          top_flag = 0;
-          size = size - 1; break; }
-        else {
-          clause[i] = tmp;
-          clause[size - 1] = last; }
-        clause[PIVOT] = pivot; } }
-*/
-    if (redundancyCheck (S, clause, size, 1) == FAILED) {
+    int *lemma = S->helpers ? copyLemma (S, clause) : clause; // the helpers are behind it
+    if (checkLemma (S, lemma, size) == FAILED) {
       printf ("c failed at proof line %i (modulo deletion errors)\n", step + 1);
       return SAT; }
+    if (lemma != clause) holdLemma (S, step, lemma);
     checked++;
     S->optproof[S->nOpt++] = ad; }
+  S->backStep = -1;
+  freeHelpers (S);
+  if (S->ratSplits)
+    printf ("c split %li RAT checks over %i threads\n", S->ratSplits, S->ratThreads);
+  if (S->kept && S->kept->released)
+    printf ("c released %.2f MB of the clause database during the backward pass, kept %.2f MB of core lemmas\n",
+            S->kept->released * sizeof (int) / 1048576.0, (S->mem_used - S->kept->base) * sizeof (int) / 1048576.0);
 
   postprocess (S);
   return UNSAT; }
@@ -1431,34 +3255,79 @@ int verify_wrap_cl_used(struct solver *S, int begin, int end, int write = 0) {
   return ret;
 }
 
-long matchClause (struct solver* S, long *clauselist, int listsize, int* input, int size) {
-  int i, j;
-  for (i = 0; i < listsize; ++i) {
-    int *clause = S->DB + clauselist[i];
-    long result;
-    for (j = 0; j <= size; j++) {
-      if (clause[j] != input[j]) goto match_next;
-    }
-
-    result = clauselist[i];
-    clauselist[i] = clauselist[--listsize];
-    return result;
-
-    match_next:;
-  }
-  return 0; }
-
-unsigned int getHash (int* input) {
-  unsigned int sum = 0, prod = 1, myxor = 0;
+// Index of the active clauses for matching deletions: open addressing with linear
+// probing over a power-of-two table of (signature, offset) slots that is rehashed into a
+// table twice the size at 3/4 load.  Offset 0 marks an empty slot
+struct slot { uint64_t key; long offset; };
+struct clauseIndex { struct slot *table; long mask, used; };
+
+// 64-bit signature of a sorted clause: a multiplicative hash of the literals in the
+// low 48 bits and the clause length in the high 16 bits, so that matchClause only
+// compares literals in S->DB when the signatures agree
+uint64_t getSignature (int* input) {
+  uint64_t hash = 0x9e3779b97f4a7c15ULL, size = 0;
   while (*input) {
-    prod *= *input; sum += *input; myxor ^= *input; input++; }
-  return (1023 * sum + prod ^ (31 * myxor)) % BIGINIT; }
+    hash = (hash ^ (uint32_t) *input++) * 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 29; size++; }
+  hash ^= hash >> 32; hash *= 0xc4ceb9fe1a85ec53ULL; hash ^= hash >> 29;
+  if (size > 0xffff) size = 0xffff;
+  return (hash & 0xffffffffffffULL) | (size << 48); }
+
+static void initIndex (struct clauseIndex *I, long expected) {
+  long size = 1 << 10;
+  while (size < expected + (expected >> 1)) size <<= 1;
+  I->table = (struct slot*) calloc (size, sizeof (struct slot));
+  if (I->table == NULL) { printf ("c MEMOUT: allocation of clause index failed\n"); exit (0); }
+  I->mask = size - 1; I->used = 0; }
+
+static void indexInsert (struct clauseIndex *I, uint64_t key, long offset) {
+  long i;
+  if (4 * (I->used + 1) > 3 * (I->mask + 1)) {
+    struct slot *old = I->table;
+    long size = I->mask + 1;
+    I->table = (struct slot*) calloc (2 * size, sizeof (struct slot));
+    if (I->table == NULL) { printf ("c MEMOUT: reallocation of clause index failed\n"); exit (0); }
+    I->mask = 2 * size - 1; I->used = 0;
+    for (i = 0; i < size; i++)
+      if (old[i].offset) indexInsert (I, old[i].key, old[i].offset);
+    free (old); }
+  for (i = key & I->mask; I->table[i].offset; i = (i + 1) & I->mask);
+  I->table[i].key = key; I->table[i].offset = offset; I->used++; }
+
+// Removes slot i and shifts later slots of the probe sequence back into the gap
+static void indexRemove (struct clauseIndex *I, long i) {
+  long j = i;
+  while (1) {
+    j = (j + 1) & I->mask;
+    if (I->table[j].offset == 0) break;
+    long home = I->table[j].key & I->mask;
+    if (((j - home) & I->mask) >= ((j - i) & I->mask)) { I->table[i] = I->table[j]; i = j; } }
+  I->table[i].offset = 0; I->used--; }
+
+// Returns the offset of a clause equal to input and removes it from the index, or 0.
+// The stream checker reorders the literals in S->DB, so there they are looked up in input
+long matchClause (struct solver* S, struct clauseIndex *I, uint64_t signature, int* input, int size) {
+  long i;
+  for (i = signature & I->mask; I->table[i].offset; i = (i + 1) & I->mask) {
+    if (I->table[i].key != signature) continue;   // early reject without touching S->DB
+    long result = I->table[i].offset;
+    int j, *clause = S->DB + result;
+    if (S->stream) {
+      for (j = 0; j < size; j++)
+        if (!bsearch (clause + j, input, size, sizeof (int), compare)) break;
+      if (j < size || clause[size]) continue; }
+    else {
+      for (j = 0; j <= size; j++)
+        if (clause[j] != input[j]) break;
+      if (j <= size) continue; }
+    indexRemove (I, i);
+    return result; }
+  return 0; }
 
 int read_lit (struct solver *S, int *lit) {
   int l = 0, lc, shift = 0;
   do {
-    lc = getc_unlocked (S->proofFile);
-    S->nReads++;
+    lc = getChar (&S->proofReader);
     if ((shift == 0) && (lc == EOF)) return EOF;
     l |= (lc & 127) << shift;
     shift += 7; }
@@ -1472,7 +3341,7 @@ int read_lit (struct solver *S, int *lit) {
 int64_t read_id (struct solver *S) {
   int64_t ret = 0;
   for(int i = 0; i < 6; i++) {
-    int64_t lc = getc_unlocked(S->proofFile);
+    int64_t lc = getChar (&S->proofReader);
     assert(lc != EOF);
     ret += lc << (8*i);
   }
@@ -1517,10 +3386,18 @@ void shuffleProof (struct solver *S, int iteration) {
       int *d = S->DB + (b >> INFOBITS);
       //int coinflip = 0;
       int coinflip = (rand ()  % 4) == 0;
-      if (c[MAXDEP] < d[MAXDEP] || (coinflip && (c[MAXDEP] < d[ID]))) {
+      long cid = clauseID (c), did = clauseID (d);
+      int same = (c[ID] < 0) == (d[ID] < 0); // only headers of the same size can trade IDs
+      if (same && (S->maxDep[cid] < S->maxDep[did] || (coinflip && (S->maxDep[cid] < clauseTime (d))))) {
         int tmp = d[ID];
         d[ID] = c[ID];
         c[ID] = tmp;
+        if (c[ID] < 0) std::swap (c[IDHIGH], d[IDHIGH]);
+        std::swap (S->maxDep[cid], S->maxDep[did]); // the cold data stays with the clause
+        if (S->cl_ids) {
+          std::swap (S->clid[cid], S->clid[did]);
+          std::swap (S->conflictNo[cid], S->conflictNo[did]);
+          std::swap (S->ancAt[cid], S->ancAt[did]); }
         S->proof[step  ] = b;
         S->proof[step-1] = a; } } }
 
@@ -1537,34 +3414,411 @@ void shuffleProof (struct solver *S, int iteration) {
       int t = clause[i]; clause[i] = clause[j]; clause[j] = t; } }
 }
 
+// Tokenizer half of parse(): reads the formula and then the proof one clause at a time
+struct tokenizer { int nZeros, *buffer, bufferAlloc, threaded, error, errorValue; };
+
+#define BADPREFIX   1		// input errors of the tokenizer
+#define BADLITERAL  2
+#define EARLYEOF    3
+
+// Reports an input error and exits.  On the tokenizer thread of --pipeline the error
+// is only recorded and the input ends there: the builder reports it once it has
+// added the clauses before it, as the serial parser does
+static int tokenError (struct solver *S, struct tokenizer *T, int error, int value) {
+  if (T->threaded) { T->error = error; T->errorValue = value; return EOF; }
+  if (error == BADPREFIX)  printf ("c ERROR: wrong binary prefix: %d\n", value);
+  if (error == BADLITERAL) printf ("c illegal literal %i due to max var %i\n", value, S->nVars);
+  exit (error == EARLYEOF ? HARDWARNING : 0); }
+
+// Reads the next clause into T->buffer and returns its size, or EOF at the end of the
+// proof.  *del is set for deletion steps and *inProof once the formula has been read
+static int readClause (struct solver *S, struct tokenizer *T, int *del, int *inProof,
+                       int64_t *clause_id, int64_t *conflict_no) {
+  struct reader *input = &S->formulaReader, *proof = &S->proofReader;
+  int tmp, size = 0;
+  *del = 0; *clause_id = *conflict_no = 0;
+  while (1) {
+    int lit = 0, fileSwitchFlag = T->nZeros <= 0; tmp = 0;
+
+    if (size == 0 && fileSwitchFlag) { // read for proof
+      if (S->binMode) {
+        int res = getChar (proof);
+        if      (res == EOF) return EOF;
+        else if (res ==  97) *del = 0; //'a'
+        else if (res == 100) *del = 1; //'d'
+        else return tokenError (S, T, BADPREFIX, res); }
+      else {
+        tmp = skipSpace (proof);
+        if (tmp == EOF) return EOF;
+        *del = tmp == 'd';
+        if (*del) proof->pos++; } }
+
+    if      (!fileSwitchFlag) tmp = readLiteral (input, &lit);  // Read a literal.
+    else if (S->binMode)      tmp = read_lit (S, &lit);
+    else                      tmp = readLiteral (proof, &lit);
+    if (tmp == EOF && !fileSwitchFlag) {
+      if (S->warning != NOWARNING) {
+        printf ("c WARNING: early EOF of the input formula\n");
+        printf ("c WARNING: %i clauses less than expected\n", T->nZeros); }
+      if (S->warning == HARDWARNING) return tokenError (S, T, EARLYEOF, 0);
+      T->nZeros = 0; size = 0; continue; }
+
+    if (tmp == 0) {
+      skipLine (fileSwitchFlag ? proof : input);
+      if (S->verb) printf ("c WARNING: parsing mismatch assuming a comment\n");
+      continue; }
+
+    if (tmp == EOF) return EOF;
+    if (abs (lit) > S->nVars && !fileSwitchFlag) return tokenError (S, T, BADLITERAL, lit);
+
+    if (lit) {
+      T->buffer[size++] = lit;                                // Add literal to buffer
+      if (size == T->bufferAlloc) { T->bufferAlloc = (T->bufferAlloc * 3) >> 1;
+        T->buffer = (int*) realloc (T->buffer, sizeof (int) * T->bufferAlloc); }
+      continue; }
+
+    //reading the binary proof with clause IDs, not deleting
+    if (fileSwitchFlag && S->binMode && S->cl_ids && *del == 0) {
+      *clause_id   = read_id (S);
+      *conflict_no = read_id (S); }
+    if (!fileSwitchFlag) T->nZeros--;
+    *inProof = fileSwitchFlag;
+    return size; } }
+
+// Builder half of parse(): sorts and deduplicates each clause, matches deletions
+// against the clause index and appends additions to S->DB
+struct builder { int nZeros, fileLine, active, retvalue; long DBsize; struct clauseIndex index; };
+
+// With --stream, parse () only reads the formula and hands its tokenizer and builder
+// over to streamProof ().  The blocks of deleted clauses wait in pending until their
+// watches are swept, and are then reused by additions of the same size.  blocks[n]
+// holds blocks with room for n literals behind the header of a narrow clause, that is
+// n - 1 behind that of a wide one, at the offset of the literals of the narrow clause
+struct stream { struct tokenizer T; struct builder B; vector<long> pending;
+                vector<vector<long> > blocks; long pendingInts, steps, reused; };
+
+// buffer must have room for a terminating zero after its size literals
+static void addClause (struct solver *S, struct builder *B, int *buffer, int size, int del, int inProof,
+                       int64_t clause_id, int64_t conflict_no) {
+  int i;
+  if (inProof && B->nZeros > 0) { // early EOF of the input formula
+    S->nClauses -= B->nZeros; B->nZeros = 0; B->fileLine = 0; }
+
+  B->fileLine++;
+  if (size > S->maxSize) S->maxSize = size;
+  for (i = 0; i < size; i++)
+    if (abs (buffer[i]) > S->maxVar) S->maxVar = abs (buffer[i]);
+  int pivot = buffer[0];
+  buffer[size] = 0;
+  qsort (buffer, size, sizeof (int), compare);
+  int j = 0;
+  for (i = 0; i < size; ++i) {
+    if (buffer[i] == buffer[i+1]) {
+      if (S->warning != NOWARNING) {
+        printf ("c WARNING: detected and deleted duplicate literal %i at position %i of line %i\n", buffer[i+1], i+1, B->fileLine); }
+      if (S->warning == HARDWARNING) exit (HARDWARNING); }
+    else { buffer[j++] = buffer[i]; } }
+  buffer[j] = 0; size = j;
+
+  if (size == 0 && !inProof) B->retvalue = UNSAT;
+
+  //deleting unit
+  if (del && S->mode == BACKWARD_UNSAT && size <= 1)  {
+    if (S->warning != NOWARNING) {
+      printf ("c WARNING: backward mode ignores deletion of (pseudo) unit clause\n");
+      /*printClause (buffer, NULL);*/ }
+    if (S->warning == HARDWARNING) exit (HARDWARNING);
+    return; }
+  int rem = buffer[0];
+  buffer[size] = 0;
+  uint64_t signature = getSignature (buffer);
+
+  //deleting long clause
+  if (del) {
+    if (S->deleted) {
+      long match = 0;
+        match = matchClause (S, &B->index, signature, buffer, size);
+        if (match == 0) {
+          if (S->warning != NOWARNING) {
+            printf ("c WARNING: deleted clause on line %i does not occur: ", B->fileLine);
+            printClause (buffer, NULL); }
+          if (S->warning == HARDWARNING) exit (HARDWARNING);
+          return; }
+        if (S->mode == FORWARD_SAT) S->DB[ match - 2 ] = rem;
+        B->active--;
+        if (S->nStep == S->nAlloc) { S->nAlloc = (S->nAlloc * 3) >> 1;
+          S->proof = (long*) realloc (S->proof, sizeof (long) * S->nAlloc);
+//          printf ("c proof allocation increased to %li\n", S->nAlloc);
+          if (S->proof == NULL) { printf("c MEMOUT: reallocation of proof list failed\n"); exit (0); } }
+        S->proof[S->nStep++] = (match << INFOBITS) + 1; }
+    return; }
+
+  int *clause;
+  struct stream *St = S->stream;
+  int wide = headerSize (S->count) - EXTRA + 1, room = size + wide;
+  if (St && room < (int) St->blocks.size () && !St->blocks[room].empty ()) {
+    clause = S->DB + St->blocks[room].back () + wide;
+    St->blocks[room].pop_back (); St->reused++; }
+  else {
+    if (S->mem_used + room + EXTRA > B->DBsize) { B->DBsize = (B->DBsize * 3) >> 1;
+      S->DB = (int *) realloc (S->DB, B->DBsize * sizeof (int));
+//      printf("c database increased to %li\n", B->DBsize);
+      if (S->DB == NULL) { printf("c MEMOUT: reallocation of clause database failed\n"); exit (0); } }
+    clause = &S->DB[S->mem_used + EXTRA - 1 + wide];
+    S->mem_used += room + EXTRA; }
+  if (size != 0) clause[PIVOT] = pivot;
+  reserveMeta (S, S->count);
+  if (S->clid) { S->clid[S->count] = clause_id; S->conflictNo[S->count] = conflict_no; }
+  setClauseID (clause, S->count); S->count++;
+  clause[REMOVED] = 0;
+  if (S->mode == FORWARD_SAT) if (B->nZeros > 0) clause[ID] |= ACTIVE;
+
+  for (i = 0; i < size; ++i) { clause[ i ] = buffer[ i ]; } clause[ i ] = 0;
+
+  indexInsert (&B->index, getSignature (clause), (long) (clause - S->DB));
+
+  B->active++;
+  if (B->nZeros > 0) { // if still parsing the formula
+    S->formula[S->nClauses - B->nZeros] = (((long) (clause - S->DB)) << INFOBITS); }
+  else {
+    if (S->nStep == S->nAlloc) { S->nAlloc = (S->nAlloc * 3) >> 1;
+      S->proof = (long*) realloc (S->proof, sizeof (long) * S->nAlloc);
+//    printf ("c proof allocation increased to %li\n", S->nAlloc);
+    if (S->proof == NULL) { printf("c MEMOUT: reallocation of proof list failed\n"); exit (0); } }
+    S->proof[S->nStep++] = (((long) (clause - S->DB)) << INFOBITS); }
+
+  if (B->nZeros <= 0) S->nLemmas++;
+
+  if (!B->nZeros) S->lemmas   = (long) (clause - S->DB); // S->lemmas is no longer pointer
+  --B->nZeros; }
+
+// The pipelined parser passes clauses from the tokenizer thread to the builder in
+// batches of BATCH ints through two lock-free single-producer single-consumer rings:
+// one for filled batches and one returning consumed batches for reuse.  A batch
+// starts with its used size, capacity and an end-of-input flag, followed by records
+// [size, del, inProof, clause_id (2 ints), conflict_no (2 ints), literals, 0]
+#define BATCH      (1 << 16)
+#define BATCH_HEAD 3
+#define RECORD     7		// ints in front of the literals of a record
+
+static int *newBatch (struct ring *unused, long capacity) {
+  int *batch = (int*) ringTryPop (unused);
+  if (batch != NULL && batch[1] < capacity) { free (batch); batch = NULL; }
+  if (batch == NULL) {
+    batch = (int*) malloc (sizeof (int) * capacity);
+    if (batch == NULL) { printf ("c MEMOUT: allocation of parse batch failed\n"); exit (0); }
+    batch[1] = capacity; }
+  batch[0] = BATCH_HEAD; batch[2] = 0;
+  return batch; }
+
+static void tokenizeBatches (struct solver *S, struct tokenizer *T, struct ring *full, struct ring *unused) {
+  int *batch = newBatch (unused, BATCH);
+  while (1) {
+    int del = 0, inProof = 0;
+    int64_t clause_id, conflict_no;
+    int size = readClause (S, T, &del, &inProof, &clause_id, &conflict_no);
+    if (size == EOF || batch[0] + size + RECORD + 1 > batch[1]) {
+      if (size == EOF) batch[2] = 1;
+      while (!ringTryPush (full, batch)) std::this_thread::yield ();
+      if (size == EOF) return;
+      batch = newBatch (unused, size + RECORD + 1 + BATCH_HEAD > BATCH ? size + RECORD + 1 + BATCH_HEAD : BATCH); }
+    int *record = batch + batch[0];
+    record[0] = size; record[1] = del; record[2] = inProof;
+    store_at (record + 3, clause_id);
+    store_at (record + 5, conflict_no);
+    memcpy (record + RECORD, T->buffer, sizeof (int) * size);
+    batch[0] += size + RECORD + 1; } }
+
+// Parallel parsing of the formula: the text after the p cnf line is split at clause
+// boundaries into one chunk per thread.  Every thread builds the clauses of its
+// chunk in the S->DB layout in a local buffer, and the chunks are then appended to
+// S->DB in file order, so that clause IDs and offsets match the serial parser
+struct cnfChunk { unsigned char *begin, *end; vector<int> db, warnings; vector<long> offsets;
+                  vector<uint64_t> signatures; long illegalClause; int illegalLit, maxSize, maxVar; };
+
+// A line start is a clause boundary if the previous line holds only numbers and ends with 0
+static int clauseBoundary (unsigned char *start, unsigned char *line) {
+  unsigned char *p = line - 1;
+  while (p > start && (*p == '\n' || *p == '\r' || *p == ' ' || *p == '\t')) p--;
+  if (p < start || *p != '0' || (p > start && p[-1] >= '0' && p[-1] <= '9') || (p > start && p[-1] == '-')) return 0;
+  while (p > start && p[-1] != '\n') {
+    p--;
+    if ((*p < '0' || *p > '9') && *p != '-' && *p != ' ' && *p != '\t' && *p != '\r') return 0; }
+  return 1; }
+
+static void parseChunk (struct solver *S, struct cnfChunk *C) {
+  struct reader R;
+  R.file = NULL; R.buf = R.pos = C->begin; R.end = C->end; R.size = C->end - C->begin; R.nBytes = 0; R.mapped = 1;
+  R.decoder = NULL;
+  vector<int> buffer;
+  C->illegalClause = -1; C->illegalLit = C->maxSize = C->maxVar = 0;
+  while (1) {
+    int lit = 0, tmp = readLiteral (&R, &lit);
+    if (tmp == EOF) break;
+    if (tmp == 0) { skipLine (&R); continue; }
+    if (lit) {
+      if (abs (lit) > S->nVars && C->illegalClause < 0) {
+        C->illegalClause = C->offsets.size (); C->illegalLit = lit; }
+      buffer.push_back (lit); continue; }
+
+    int i, j = 0, size = buffer.size ();
+    if (size > C->maxSize) C->maxSize = size;
+    int pivot = size ? buffer[0] : 0;
+    buffer.push_back (0);
+    qsort (buffer.data (), size, sizeof (int), compare);
+    for (i = 0; i < size; ++i) {
+      if (buffer[i] == buffer[i+1]) {
+        C->warnings.push_back (C->offsets.size ()); C->warnings.push_back (buffer[i+1]); C->warnings.push_back (i+1); }
+      else { buffer[j++] = buffer[i]; } }
+    buffer[j] = 0; size = j;
+    long at = C->db.size ();
+    C->db.resize (at + size + EXTRA, 0);
+    int *clause = C->db.data () + at + EXTRA - 1;
+    if (size != 0) clause[PIVOT] = pivot;
+    for (i = 0; i < size; ++i) {
+      clause[i] = buffer[i];
+      if (abs (buffer[i]) > C->maxVar) C->maxVar = abs (buffer[i]); }
+    C->offsets.push_back (at + EXTRA - 1);
+    C->signatures.push_back (getSignature (clause));
+    buffer.clear (); } }
+
+// Gives the clauses from up to n of C the header of a wide clause, for IDs beyond MAXID
+static void widenChunk (struct cnfChunk *C, long from, long n) {
+  long i, end = n < (long) C->offsets.size () ? C->offsets[n] - EXTRA + 1 : (long) C->db.size ();
+  C->db.insert (C->db.begin () + end, n - from, 0);
+  for (i = n - 1; i >= from; i--) {
+    long start = C->offsets[i] - EXTRA + 1, shift = i - from + 1;
+    long stop = i + 1 < n ? C->offsets[i + 1] - EXTRA - shift : end; // offsets[i + 1] moved by shift + 1
+    memmove (C->db.data () + start + shift, C->db.data () + start, sizeof (int) * (stop - start));
+    C->offsets[i] += shift; } }
+
+static int parseFormulaParallel (struct solver *S, struct tokenizer *T, struct builder *B) {
+  struct reader *input = &S->formulaReader;
+  int t, nThreads = S->parseThreads;
+  if (nThreads <= 1 || !input->mapped || T->nZeros <= 0) return 0;
+
+  vector<struct cnfChunk> chunks (nThreads);
+  unsigned char *start = input->pos, *end = input->end;
+  for (t = 0; t < nThreads; t++) {
+    unsigned char *p = start + (end - start) * t / nThreads;
+    if (t == 0) p = start;
+    else {
+      if (p < chunks[t-1].begin) p = chunks[t-1].begin;
+      while (p < end) {
+        while (p < end && *p != '\n') p++;
+        if (p < end) p++;
+        if (p == end || clauseBoundary (start, p)) break; } }
+    chunks[t].begin = p;
+    if (t) chunks[t-1].end = p; }
+  chunks[nThreads-1].end = end;
+
+  vector<std::thread> threads;
+  for (t = 1; t < nThreads; t++) threads.push_back (std::thread (parseChunk, S, &chunks[t]));
+  parseChunk (S, &chunks[0]);
+  for (t = 0; t < nThreads - 1; t++) threads[t].join ();
+
+  // append the chunks in file order, ignoring clauses beyond the declared number
+  long parsed = 0;
+  for (t = 0; t < nThreads && parsed < S->nClauses; t++) {
+    struct cnfChunk *C = &chunks[t];
+    long i, n = C->offsets.size ();
+    if (parsed + n > S->nClauses) n = S->nClauses - parsed;
+    long valid = (C->illegalClause >= 0 && C->illegalClause < n) ? C->illegalClause : n;
+    for (i = 0; i < (long) C->warnings.size (); i += 3) {
+      if (C->warnings[i] >= valid) break;
+      if (S->warning != NOWARNING) {
+        printf ("c WARNING: detected and deleted duplicate literal %i at position %i of line %li\n", C->warnings[i+1], C->warnings[i+2], parsed + C->warnings[i] + 1); }
+      if (S->warning == HARDWARNING) exit (HARDWARNING); }
+    if (valid < n) {
+      printf ("c illegal literal %i due to max var %i\n", C->illegalLit, S->nVars); exit (0); }
+    long used = n < (long) C->offsets.size () ? C->offsets[n] - EXTRA + 1 : (long) C->db.size ();
+    long wide = std::min (n, std::max (0L, S->count + n - 1 - MAXID)); // clauses that need IDHIGH
+    if (S->mem_used + used + wide > B->DBsize) {
+      while (S->mem_used + used + wide > B->DBsize) B->DBsize = (B->DBsize * 3) >> 1;
+      S->DB = (int *) realloc (S->DB, B->DBsize * sizeof (int));
+      if (S->DB == NULL) { printf("c MEMOUT: reallocation of clause database failed\n"); exit (0); } }
+    if (wide) widenChunk (C, n - wide, n);
+    memcpy (S->DB + S->mem_used, C->db.data (), (used + wide) * sizeof (int));
+    used += wide;
+    reserveMeta (S, S->count + n);
+    for (i = 0; i < n; i++) {
+      int *clause = S->DB + S->mem_used + C->offsets[i];
+      setClauseID (clause, S->count); S->count++;
+      if (S->mode == FORWARD_SAT) clause[ID] |= ACTIVE;
+      if (clause[0] == 0) B->retvalue = UNSAT;
+      indexInsert (&B->index, C->signatures[i], (long) (clause - S->DB));
+      S->formula[parsed + i] = (((long) (clause - S->DB)) << INFOBITS); }
+    S->mem_used += used;
+    parsed += n;
+    if (C->maxSize > S->maxSize) S->maxSize = C->maxSize;
+    if (C->maxVar  > S->maxVar ) S->maxVar  = C->maxVar; }
+
+  if (parsed < S->nClauses) {
+    if (S->warning != NOWARNING) {
+      printf ("c WARNING: early EOF of the input formula\n");
+      printf ("c WARNING: %li clauses less than expected\n", S->nClauses - parsed); }
+    if (S->warning == HARDWARNING) exit (HARDWARNING);
+    S->nClauses = parsed; B->fileLine = 0; }
+  else B->fileLine = parsed;
+  B->active += parsed;
+  B->nZeros = T->nZeros = 0;
+  input->pos = end;
+  return 1; }
+
+#ifdef HAVE_MMAP
+// An anonymous file in dir for the LRAT dependencies.  It is unlinked right away, so
+// it disappears with the process
+static struct writer *openSpill (const char *dir) {
+  char *path = (char *) malloc (strlen (dir) + 32);
+  sprintf (path, "%s/drat-trim-lrat-XXXXXX", dir);
+  int fd = mkstemp (path);
+  FILE *file = fd < 0 ? NULL : fdopen (fd, "w+");
+  if (file == NULL) {
+    printf ("c WARNING: could not create a spill file in %s; keeping the LRAT dependencies in memory\n", dir);
+    free (path); return NULL; }
+  unlink (path); free (path);
+  return openWriter (file); }
+#endif
+
 int parse (struct solver* S) {
-  int tmp, active = 0, retvalue = SAT;
-  int del = 0, fileLine = 0;
-  int *buffer, bufferAlloc;
+  int tmp, i;
 
   S->nVars    = 0;
   S->nClauses = 0;
-  do { tmp = fscanf (S->inputFile, " cnf %i %li \n", &S->nVars, &S->nClauses); // Read the first line
-    if (tmp > 0 && tmp != EOF) break; tmp = fscanf (S->inputFile, "%*s\n"); }  // In case a commment line was found
-  while (tmp != 2 && tmp != EOF);                                              // Skip it and read next line
-  int nZeros = S->nClauses;
+  double parse_time = wallTime ();
+  struct reader *input = &S->formulaReader, *proof = &S->proofReader;
+  while (skipSpace (input) != EOF) {                       // Skip words until "cnf"
+    if (getChar (input) != 'c' || getChar (input) != 'n' || getChar (input) != 'f' ||
+        (peekChar (input) != ' ' && peekChar (input) != '\t')) {
+      while ((tmp = peekChar (input)) != EOF && tmp != ' ' && tmp != '\n' && tmp != '\t' && tmp != '\r') input->pos++;
+      continue; }
+    long nVars = 0;
+    if (readNumber (input, &nVars) == 1 && readNumber (input, &S->nClauses) == 1) {
+      S->nVars = nVars; break; } }
 
   if (!S->nVars && !S->nClauses) {
     printf ("c ERROR: did not find p cnf line in input file\n"); exit (0); }
 
   printf ("c parsing input formula with %i variables and %li clauses\n", S->nVars, S->nClauses);
 
-  bufferAlloc = INIT;
-  buffer = (int*) malloc (sizeof (int) * bufferAlloc);
+  struct tokenizer T;
+  T.nZeros      = S->nClauses;
+  T.bufferAlloc = INIT;
+  T.threaded    = T.error = 0;
+  T.buffer      = (int*) malloc (sizeof (int) * T.bufferAlloc);
 
   S->count    = 1;
   S->nStep    = 0;
   S->mem_used = 0;                  // The number of integers allocated in the DB
 
-  long size;
-  long DBsize = S->mem_used + BIGINIT;
-  S->DB = (int*) malloc (DBsize * sizeof (int));
-  if (S->DB == NULL) { free (buffer); return ERROR; }
+  struct builder B;
+  B.nZeros   = S->nClauses;
+  B.fileLine = 0;
+  B.active   = 0;
+  B.retvalue = SAT;
+  B.DBsize   = S->mem_used + BIGINIT;
+  S->DB = (int*) malloc (B.DBsize * sizeof (int));
+  if (S->DB == NULL) { free (T.buffer); return ERROR; }
 
   S->maxVar  = 0;
   S->maxSize = 0;
@@ -1572,258 +3826,288 @@ int parse (struct solver* S) {
   S->nAlloc  = BIGINIT;
   S->formula = (long *) malloc (sizeof (long) * S->nClauses);
   S->proof   = (long *) malloc (sizeof (long) * S->nAlloc);
-  long **hashTable = (long**) malloc (sizeof (long*) * BIGINIT);
-  int   *hashUsed  = (int * ) malloc (sizeof (int  ) * BIGINIT);
-  int   *hashMax   = (int * ) malloc (sizeof (int  ) * BIGINIT);
-
-  int i;
-  for (i = 0; i < BIGINIT; i++) {
-    hashUsed [i] = 0;
-    hashMax  [i] = INIT;
-    hashTable[i] = (long*) malloc (sizeof (long) * hashMax[i]); }
-
-  //if it's 1 then we are reading the proof
-  int fileSwitchFlag = 0;
-  size = 0;
-  while (1) {
-    int lit = 0; tmp = 0;
-    fileSwitchFlag = nZeros <= 0;
-
-    if (size == 0) {
-      if (fileSwitchFlag) { // read for proof
-        if (S->binMode) {
-          int res = getc_unlocked (S->proofFile);
-          if      (res == EOF) break;
-          else if (res ==  97) del = 0; //'a'
-          else if (res == 100) del = 1; //'d'
-          else { printf ("c ERROR: wrong binary prefix: %d\n", res); exit (0); }
-          S->nReads++; }
-        else {
-          tmp = fscanf (S->proofFile, " d  %i ", &lit);
-          if (tmp == EOF) break;
-          del = tmp > 0; } } }
-
-    if (!lit) {
-      if (!fileSwitchFlag) tmp = fscanf (S->inputFile, " %i ", &lit);  // Read a literal.
-      else {
-        if (S->binMode) {
-          tmp = read_lit (S, &lit); }
-        else {
-          tmp = fscanf (S->proofFile, " %i ", &lit); } }
-      if (tmp == EOF && !fileSwitchFlag) {
-        if (S->warning != NOWARNING) {
-          printf ("c WARNING: early EOF of the input formula\n");
-          printf ("c WARNING: %i clauses less than expected\n", nZeros); }
-        if (S->warning == HARDWARNING) exit (HARDWARNING);
-        fileLine = 0;
-        fileSwitchFlag = 1; } }
-
-    if (tmp == 0) {
-      char ignore[1024];
-      if (!fileSwitchFlag) { if (fgets (ignore, sizeof (ignore), S->inputFile) == NULL) printf ("c\n"); }
-      else if (fgets (ignore, sizeof (ignore), S->proofFile) == NULL) printf ("c\n");
-      for (i = 0; i < 1024; i++) { if (ignore[i] == '\n') break; }
-      if (i == 1024) {
-        printf ("c ERROR: comment longer than 1024 characters: %s\n", ignore);
-        exit (HARDWARNING); }
-      if (S->verb) printf ("c WARNING: parsing mismatch assuming a comment\n");
-      continue; }
-
-    if (abs (lit) > S->maxVar) S->maxVar = abs (lit);
-    if (tmp == EOF && fileSwitchFlag) break;
-    if (abs (lit) > S->nVars && !fileSwitchFlag) {
-      printf ("c illegal literal %i due to max var %i\n", lit, S->nVars); exit (0); }
-
-    //end-of-clause
-    if (!lit) {
-      int64_t clause_id = 0;
-      int64_t conflict_no = 0;
-
-      //reading the binary proof with clause IDs, not deleting
-      if (fileSwitchFlag && S->binMode && S->cl_ids && del == 0) {
-          clause_id = read_id(S);
-          //printf("%" PRId64 " Read ID\n", clause_id);
-//           printf("clause_id: %ld", clause_id);
-          conflict_no = read_id(S);
-//           printf(" conflict_no: %ld\n", conflict_no);
-          //printf("ID is: %" PRId64 " sum conflict is: %" PRId64 "\n", clause_id, conflict_no);
-      }
-      fileLine++;
-      if (size > S->maxSize) S->maxSize = size;
-      int pivot = buffer[0];
-      buffer[size] = 0;
-      qsort (buffer, size, sizeof (int), compare);
-      int j = 0;
-      for (i = 0; i < size; ++i) {
-        if (buffer[i] == buffer[i+1]) {
-          if (S->warning != NOWARNING) {
-            printf ("c WARNING: detected and deleted duplicate literal %i at position %i of line %i\n", buffer[i+1], i+1, fileLine); }
-          if (S->warning == HARDWARNING) exit (HARDWARNING); }
-        else { buffer[j++] = buffer[i]; } }
-      buffer[j] = 0; size = j;
-
-      if (size == 0 && !fileSwitchFlag) retvalue = UNSAT;
-
-      //deleting unit
-      if (del && S->mode == BACKWARD_UNSAT && size <= 1)  {
-        if (S->warning != NOWARNING) {
-          printf ("c WARNING: backward mode ignores deletion of (pseudo) unit clause\n");
-          /*printClause (buffer, NULL);*/ }
-        if (S->warning == HARDWARNING) exit (HARDWARNING);
-        del = 0; size = 0; continue; }
-      int rem = buffer[0];
-      buffer[size] = 0;
-      unsigned int hash = getHash (buffer);
-
-      //deleting long clause
-      if (del) {
-        if (S->deleted) {
-          long match = 0;
-            match = matchClause (S, hashTable[hash], hashUsed[hash], buffer, size);
-            if (match == 0) {
-              if (S->warning != NOWARNING) {
-                printf ("c WARNING: deleted clause on line %i does not occur: ", fileLine);
-                printClause (buffer, NULL); }
-              if (S->warning == HARDWARNING) exit (HARDWARNING);
-              goto end_delete; }
-            if (S->mode == FORWARD_SAT) S->DB[ match - 2 ] = rem;
-            hashUsed[hash]--;
-            active--;
-            if (S->nStep == S->nAlloc) { S->nAlloc = (S->nAlloc * 3) >> 1;
-              S->proof = (long*) realloc (S->proof, sizeof (long) * S->nAlloc);
-//              printf ("c proof allocation increased to %li\n", S->nAlloc);
-              if (S->proof == NULL) { printf("c MEMOUT: reallocation of proof list failed\n"); exit (0); } }
-            S->proof[S->nStep++] = (match << INFOBITS) + 1; }
-        end_delete:;
-        if (del) { del = 0; size = 0; continue; } }
-
-      if (S->mem_used + size + EXTRA > DBsize) { DBsize = (DBsize * 3) >> 1;
-        S->DB = (int *) realloc (S->DB, DBsize * sizeof (int));
-//        printf("c database increased to %li\n", DBsize);
-        if (S->DB == NULL) { printf("c MEMOUT: reallocation of clause database failed\n"); exit (0); } }
-
-      int *clause = &S->DB[S->mem_used + EXTRA - 1];
-      if (size != 0) clause[PIVOT] = pivot;
-      clause[ID] = 2 * S->count; S->count++;
-      store_at(clause+CLID, clause_id);
-      store_at(clause+CONFLICT_NO, conflict_no);
-      store_at(clause+ANC_DATA_AT, 0);
-      if (S->mode == FORWARD_SAT) if (nZeros > 0) clause[ID] |= ACTIVE;
-
-      for (i = 0; i < size; ++i) { clause[ i ] = buffer[ i ]; } clause[ i ] = 0;
-      S->mem_used += size + EXTRA;
-
-      hash = getHash (clause);
-      if (hashUsed[hash] == hashMax[hash]) { hashMax[hash] = (hashMax[hash] * 3) >> 1;
-        hashTable[hash] = (long *) realloc (hashTable[hash], sizeof (long*) * hashMax[hash]);
-        if (hashTable[hash] == NULL) { printf("c MEMOUT reallocation of hash table %i failed\n", hash); exit (0); } }
-      hashTable[ hash ][ hashUsed[hash]++ ] = (long) (clause - S->DB);
-
-      active++;
-      if (nZeros > 0) { // if still parsing the formula
-        S->formula[S->nClauses - nZeros] = (((long) (clause - S->DB)) << INFOBITS); }
-      else {
-        if (S->nStep == S->nAlloc) { S->nAlloc = (S->nAlloc * 3) >> 1;
-          S->proof = (long*) realloc (S->proof, sizeof (long) * S->nAlloc);
-//        printf ("c proof allocation increased to %li\n", S->nAlloc);
-        if (S->proof == NULL) { printf("c MEMOUT: reallocation of proof list failed\n"); exit (0); } }
-        S->proof[S->nStep++] = (((long) (clause - S->DB)) << INFOBITS); }
-
-      if (nZeros <= 0) S->nLemmas++;
-
-      if (!nZeros) S->lemmas   = (long) (clause - S->DB); // S->lemmas is no longer pointer
-      size = 0; del = 0; --nZeros; }                      // Reset buffer
-   else {
-     buffer[size++] = lit;                                // Add literal to buffer
-     if (size == bufferAlloc) { bufferAlloc = (bufferAlloc * 3) >> 1;
-       buffer = (int*) realloc (buffer, sizeof (int) * bufferAlloc); } } }
+  // size the index for the formula plus a guess of the lemmas in a mapped proof
+  initIndex (&B.index, S->nClauses + (proof->mapped && !S->stream ? proof->size / 64 : 0));
+
+  parseFormulaParallel (S, &T, &B);
+
+  if (S->stream) { // the proof is read by streamProof () while it is checked
+    int size, del, inProof;
+    int64_t clause_id, conflict_no;
+    while (T.nZeros > 0 && (size = readClause (S, &T, &del, &inProof, &clause_id, &conflict_no)) != EOF)
+      addClause (S, &B, T.buffer, size, del, inProof, clause_id, conflict_no); }
+  else if (S->pipeline) { // tokenize on a second thread while this one builds the database
+    struct ring full, unused;
+    full.head = full.tail = unused.head = unused.tail = 0;
+    T.threaded = 1;
+    std::thread tokenizer (tokenizeBatches, S, &T, &full, &unused);
+    int last = 0;
+    while (!last) {
+      int *batch;
+      while ((batch = (int*) ringTryPop (&full)) == NULL) std::this_thread::yield ();
+      int *record = batch + BATCH_HEAD;
+      while (record < batch + batch[0]) {
+        addClause (S, &B, record + RECORD, record[0], record[1], record[2],
+                   get_at (record, 3), get_at (record, 5));
+        record += record[0] + RECORD + 1; }
+      last = batch[2];
+      if (!ringTryPush (&unused, batch)) free (batch); }
+    tokenizer.join ();
+    T.threaded = 0;
+    if (T.error) tokenError (S, &T, T.error, T.errorValue);
+    int *batch;
+    while ((batch = (int*) ringTryPop (&unused)) != NULL) free (batch); }
+  else {
+    int size, del, inProof;
+    int64_t clause_id, conflict_no;
+    while ((size = readClause (S, &T, &del, &inProof, &clause_id, &conflict_no)) != EOF)
+      addClause (S, &B, T.buffer, size, del, inProof, clause_id, conflict_no); }
+  if (B.nZeros > 0) { S->nClauses -= B.nZeros; B.nZeros = 0; }
+  int active = B.active, retvalue = B.retvalue;
 
   if (S->mode == FORWARD_SAT && active) {
     if (S->warning != NOWARNING)
       printf ("c WARNING: %i clauses active if proof succeeds\n", active);
     if (S->warning == HARDWARNING) exit (HARDWARNING);
-    for (i = 0; i < BIGINIT; i++) {
-      int j;
-      for (j = 0; j < hashUsed[i]; j++) {
-        printf ("c ");
-        int *clause = S->DB + hashTable [i][j];
-        printClause (clause, S);
-        if (S->nStep == S->nAlloc) { S->nAlloc = (S->nAlloc * 3) >> 1;
-          S->proof = (long*) realloc (S->proof, sizeof (long) * S->nAlloc);
+    vector<long> remaining;                           // report them in database order
+    for (i = 0; i <= B.index.mask; i++)
+      if (B.index.table[i].offset) remaining.push_back (B.index.table[i].offset);
+    std::sort (remaining.begin (), remaining.end ());
+    for (long offset : remaining) {
+      printf ("c ");
+      int *clause = S->DB + offset;
+      printClause (clause, S);
+      if (S->nStep == S->nAlloc) { S->nAlloc = (S->nAlloc * 3) >> 1;
+        S->proof = (long*) realloc (S->proof, sizeof (long) * S->nAlloc);
 //          printf ("c proof allocation increased to %li\n", S->nAlloc);
-          if (S->proof == NULL) { printf("c MEMOUT: reallocation of proof list failed\n"); exit (0); } }
-        S->proof[S->nStep++] = (((int) (clause - S->DB)) << INFOBITS) + 1; } } }
-
-  S->DB = (int *) realloc (S->DB, S->mem_used * sizeof (int));
-
-  for (i = 0; i < BIGINIT; i++) free (hashTable[i]);
-  free (hashTable);
-  free (hashUsed);
-  free (hashMax);
-  free (buffer);
+        if (S->proof == NULL) { printf("c MEMOUT: reallocation of proof list failed\n"); exit (0); } }
+      S->proof[S->nStep++] = (((long) (clause - S->DB)) << INFOBITS) + 1; } }
 
-  printf ("c finished parsing");
+  if (S->stream) { S->stream->T = T; S->stream->B = B; }
+  else {
+    S->DB = (int *) realloc (S->DB, S->mem_used * sizeof (int));
+    free (B.index.table);
+    free (T.buffer); }
+
+  closeReader (input);
+  if (!S->stream) closeReader (proof);
+  S->nReads = proof->nBytes;
+  parse_time = wallTime () - parse_time;
+  printf ("c finished parsing%s", S->stream ? " the formula" : "");
   if (S->nReads) printf (", read %li bytes from proof file", S->nReads);
   printf ("\n");
+  double megabytes = (input->nBytes + proof->nBytes) / 1048576.0;
+  printf ("c parsed %.2f MB in %.3f seconds (%.2f MB/s)\n", megabytes, parse_time,
+          parse_time > 0 ? megabytes / parse_time : 0.0);
 
+  if (S->stream && S->nVars > S->maxVar) S->maxVar = S->nVars;
   int n = S->maxVar;
   S->falseStack = (int  *) malloc ((    n + 1) * sizeof (int )); // Stack of falsified literals -- this pointer is never changed
-  S->reason     = (long *) malloc ((    n + 1) * sizeof (long)); // Array of clauses
-  S->used       = (int  *) malloc ((2 * n + 1) * sizeof (int )); S->used     += n; // Labels for variables, non-zero means false
-  S->max        = (int  *) malloc ((2 * n + 1) * sizeof (int )); S->max      += n; // Labels for variables, non-zero means false
-  S->falsified      = (int  *) malloc ((2 * n + 1) * sizeof (int )); S->falsified    += n; // Labels for variables, non-zero means false
+  S->reason     = (long *) malloc ((    n + 1) * sizeof (long)); // Reasons: DB offsets + 1, so as wide as those
+  S->falsified  = (int8_t*) malloc ((2 * n + 1) * sizeof (int8_t)); S->falsified += n; // Labels for variables, non-zero means false
   S->setMap     = (int  *) malloc ((2 * n + 1) * sizeof (int )); S->setMap   += n; // Labels for variables, non-zero means false
   S->setTruth   = (int  *) malloc ((2 * n + 1) * sizeof (int )); S->setTruth += n; // Labels for variables, non-zero means false
 
-  S->optproof   = (long *) malloc (sizeof(long) * (2 * S->nLemmas + S->nClauses));
+  S->optproof   = (long *) malloc (sizeof(long) * (2L * S->nLemmas + S->nClauses));
 
   S->maxRAT = INIT;
-  S->RATset = (int*) malloc (sizeof (int) * S->maxRAT);
+  S->RATset = (long*) malloc (sizeof (long) * S->maxRAT);
   for (i = 0; i < S->maxRAT; i++) S->RATset[i] = 0; // is this required?
 
-  S->preRAT = (int*) malloc (sizeof (int) * n);
+  S->preRAT = (long*) malloc (sizeof (long) * n);
 
   S->lratAlloc  = INIT;
   S->lratSize   = 0;
   S->lratTable  = (int  *) malloc (sizeof(int ) * S->lratAlloc);
   S->lratLookup = (long *) malloc (sizeof(long) * (S->count + 1));
+#ifdef HAVE_MMAP
+  if (S->lratFile && S->spillDir) S->lratSpill = openSpill (S->spillDir);
+#endif
 
   S->maxDependencies = INIT;
-  S->dependencies = (int*) malloc (sizeof (int) * S->maxDependencies);
+  S->dependencies = (long*) malloc (sizeof (long) * S->maxDependencies);
   for (i = 0; i < S->maxDependencies; i++) S->dependencies[i] = 0;  // is this required?
 
-  S->wlist = (long**) malloc (sizeof (long*) * (2*n+1)); S->wlist += n;
+  S->wlist = (struct watches*) malloc (sizeof (struct watches) * (2*n+1)); S->wlist += n;
+  S->blist = (struct watches*) malloc (sizeof (struct watches) * (2*n+1)); S->blist += n;
+  S->occurs = (struct occurs*) calloc (2*n+1, sizeof (struct occurs)); S->occurs += n;
+  S->occursBuilt = 0;
+  S->arenaSize  = S->arenaPeak = 4L * n * INIT;
+  S->arenaTop   = S->arenaWaste = 0;
+  S->arena      = (long*) malloc (sizeof (long) * (S->arenaSize + 1));
+  if (S->arena == NULL) { printf("c MEMOUT: allocation of watch arena failed\n"); exit (0); }
+
+  for (i = -n; i <= n; ++i) {
+    if (i == 0) continue;
+    struct watches *W[2] = { S->wlist + i, S->blist + i };
+    for (int k = 0; k < 2; k++) {
+      W[k]->start = S->arenaTop; W[k]->used = W[k]->stale = 0; W[k]->max = INIT;
+      S->arena[S->arenaTop] = END; S->arenaTop += INIT; } }
 
-  for (i = 1; i <= n; ++i) { S->max     [ i] = S->max     [-i] = INIT;
-                             S->setMap  [ i] = S->setMap  [-i] =    0;
-                             S->setTruth[ i] = S->setTruth[-i] =    0;
-                             S->wlist   [ i] = (long*) malloc (sizeof (long) * S->max[ i]);
-                             S->wlist   [-i] = (long*) malloc (sizeof (long) * S->max[-i]); }
+  for (i = 1; i <= n; ++i) { S->setMap  [ i] = S->setMap  [-i] =    0;
+                             S->setTruth[ i] = S->setTruth[-i] =    0; }
 
   S->unitStack = (long *) malloc (sizeof (long) * n);
 
   return retvalue; }
 
+// Moves an array of 2 * old + 1 elements centered on element old into a zeroed one
+// of 2 * n + 1 elements, and returns a pointer to its center
+static void *growCentered (void *array, size_t size, int old, int n) {
+  char *grown = (char*) calloc (2L * n + 1, size);
+  if (grown == NULL) { printf ("c MEMOUT: reallocation of variable arrays failed\n"); exit (0); }
+  memcpy (grown + size * (n - old), (char*) array - size * old, size * (2L * old + 1));
+  free ((char*) array - size * old);
+  return grown + size * n; }
+
+// Makes room for var in the arrays that parse () sized for the variables of the
+// formula.  The stream checker calls it when a lemma introduces a new variable
+static void growVars (struct solver *S, int var) {
+  int i, k, old = S->maxVar, n = old + (old >> 1);
+  if (n < var) n = var;
+  int *oldStack = S->falseStack;
+  long forced = S->forced - oldStack, processed = S->processed - oldStack,
+       assigned = S->assigned - oldStack;
+  S->falseStack = (int  *) realloc (oldStack, (n + 1) * sizeof (int ));
+  if (S->falseStack == NULL) { printf ("c MEMOUT: reallocation of variable arrays failed\n"); exit (0); }
+  S->forced = S->falseStack + forced; S->processed = S->falseStack + processed;
+  S->assigned = S->falseStack + assigned;
+  S->reason     = (long *) realloc (S->reason,     (n + 1) * sizeof (long));
+  S->preRAT     = (long *) realloc (S->preRAT,     n * sizeof (long));
+  S->unitStack  = (long *) realloc (S->unitStack,  n * sizeof (long));
+  if (!S->reason || !S->preRAT || !S->unitStack) {
+    printf ("c MEMOUT: reallocation of variable arrays failed\n"); exit (0); }
+  for (i = old + 1; i <= n; i++) S->falseStack[i] = S->reason[i] = 0;
+
+  S->falsified = (int8_t*) growCentered (S->falsified, sizeof (int8_t), old, n);
+  S->setMap    = (int *) growCentered (S->setMap,   sizeof (int), old, n);
+  S->setTruth  = (int *) growCentered (S->setTruth, sizeof (int), old, n);
+  S->wlist  = (struct watches*) growCentered (S->wlist,  sizeof (struct watches), old, n);
+  S->blist  = (struct watches*) growCentered (S->blist,  sizeof (struct watches), old, n);
+  S->occurs = (struct occurs *) growCentered (S->occurs, sizeof (struct occurs ), old, n);
+
+  long top = S->arenaTop + 4L * (n - old) * INIT;
+  if (top > S->arenaSize) {
+    S->arenaSize = top + (top >> 1);
+    S->arena = (long *) realloc (S->arena, sizeof (long) * (S->arenaSize + 1));
+    if (S->arena == NULL) { printf("c MEMOUT: reallocation of watch arena failed\n"); exit (0); }
+    if (S->arenaSize > S->arenaPeak) S->arenaPeak = S->arenaSize; }
+  for (i = old + 1; i <= n; i++) {
+    struct watches *W[4] = { S->wlist + i, S->wlist - i, S->blist + i, S->blist - i };
+    for (k = 0; k < 4; k++) {
+      W[k]->start = S->arenaTop; W[k]->used = W[k]->stale = 0; W[k]->max = INIT;
+      S->arena[S->arenaTop] = END; S->arenaTop += INIT; } }
+  S->maxVar = n; }
+
+// Once the pending blocks make up an eighth of the database, all watch lists are swept,
+// so that no stale watch refers to them any more, and the blocks become reusable
+static void releaseBlock (struct solver *S, int *clause) {
+  struct stream *St = S->stream;
+  int i, size = 0;
+  while (clause[size]) size++;
+  St->pending.push_back ((long) (clause - S->DB));
+  St->pendingInts += size + EXTRA + (clause[ID] < 0);
+  if (8 * St->pendingInts < S->mem_used || St->pendingInts < 2L * S->maxVar) return;
+  for (i = -S->maxVar; i <= S->maxVar; i++)
+    if (i) { sweepWatches (S, S->wlist + i); sweepWatches (S, S->blist + i); }
+  for (long offset : St->pending) {
+    int wide = S->DB[offset + ID] < 0;
+    for (size = wide; S->DB[offset + size - wide]; size++);
+    if (size >= (int) St->blocks.size ()) St->blocks.resize (size + 1);
+    St->blocks[size].push_back (offset - wide); }
+  St->pending.clear (); St->pendingInts = 0; }
+
+// Checks one step as verify () does in forward mode, but releases deleted clauses.
+// Returns UNSAT once the conflict is found and FAILED if the step does not check
+static int streamStep (struct solver *S, long ad) {
+  long d = ad & 1;
+  int *lemmas = S->DB + (ad >> INFOBITS);
+  S->time = clauseTime (lemmas);
+
+  if (!lemmas[1]) { // found a unit
+    if (d) return SAT; // no need to remove units while checking UNSAT
+    addUnit (S, (long) (lemmas - S->DB)); }
+
+  if (d) {
+    if ((S->reason[abs (lemmas[0])] - 1) == (lemmas - S->DB)) return SAT; // pseudo unit
+    removeWatch (S, lemmas, 0), removeWatch (S, lemmas, 1); removeOccurs (S, lemmas);
+    releaseBlock (S, lemmas);
+    return SAT; }
+
+  int size = sortSize (S, lemmas);
+  if (size < 0) return SAT;
+  if (redundancyCheck (S, lemmas, size, 1) == FAILED) return FAILED;
+  size = sortSize (S, lemmas);
+  S->nDependencies = 0; S->current = NULL;
+
+  if (lemmas[1])
+    addWatch (S, lemmas, 0), addWatch (S, lemmas, 1), addOccurs (S, lemmas);
+
+  if (size == 0) {
+    printf ("c conflict claimed, but not detected\n"); return FAILED; }
+  if (size == 1) {
+    if (S->verb) printf ("c found unit %i\n", lemmas[0]);
+    assign (S, lemmas[0]); S->reason[abs (lemmas[0])] = ((long) ((lemmas)-S->DB)) + 1;
+    if (propagate (S, 1, 1, getConflictNo (S, lemmas), NULL) == UNSAT) return UNSAT;
+    S->forced = S->processed; }
+  return SAT; }
+
+// Checks the proof while it is read (--stream): each step is added to S->DB by
+// addClause () and checked right away, so S->DB holds the live clauses rather than
+// the whole proof, and nothing is kept for -c, -l or -L
+static int streamProof (struct solver *S) {
+  struct stream *St = S->stream;
+  int i, size, del, inProof, status = SAT;
+  int64_t clause_id, conflict_no;
+  printf ("c start streaming forward verification\n");
+  while (1) {
+    for (i = 0; i < S->nStep && status == SAT; i++, St->steps++)
+      status = streamStep (S, S->proof[i]);
+    S->nStep = 0;
+    if (status != SAT) break;
+    if ((size = readClause (S, &St->T, &del, &inProof, &clause_id, &conflict_no)) == EOF) break;
+    for (i = 0; i < size; i++)
+      if (abs (St->T.buffer[i]) > S->maxVar) growVars (S, abs (St->T.buffer[i]));
+    addClause (S, &St->B, St->T.buffer, size, del, inProof, clause_id, conflict_no); }
+
+  S->nReads = readerBytes (&S->proofReader);
+  printf ("c streamed %li proof steps (%li bytes), reusing %li clause blocks\n",
+          St->steps, S->nReads, St->reused);
+  printf ("c clause database peaked at %.2f MB\n", S->mem_used * sizeof (int) / 1048576.0);
+  if (status == UNSAT) return UNSAT;
+  if (status == FAILED)
+    printf ("c failed at proof line %li (modulo deletion errors)\n", St->steps);
+  else printf ("c ERROR: all lemmas verified, but no conflict\n");
+  return SAT; }
+
 void freeMemory (struct solver *S) {
-  int i;
 //  printf("c database size %li; ", S->mem_used);
-//  int sum = 0;
-//  for (i = 1; i <= S->maxVar; i++)
-//    sum += S->max[i] + S->max[-i];
-//  printf(" watch pointers size %i.\n", sum);
+//  printf(" watch arena size %li.\n", S->arenaSize);
 
   free (S->DB);
   free (S->falseStack);
   free (S->reason);
   free (S->proof);
   free (S->formula);
-  for (i = 1; i <= S->maxVar; ++i) { free (S->wlist[i]); free (S->wlist[-i]); }
-  free (S->used  - S->maxVar);
-  free (S->max   - S->maxVar);
+  free (S->arena);
   free (S->falsified - S->maxVar);
   free (S->wlist - S->maxVar);
+  free (S->blist - S->maxVar);
+  for (int i = -S->maxVar; i <= S->maxVar; i++) free (S->occurs[i].list);
+  free (S->occurs - S->maxVar);
   free (S->RATset);
   free (S->dependencies);
+  free (S->scratch);
+  freeHelpers (S);
+  freeWriter (S->lratFile);
+  freeWriter (S->lratSpill);
+  free (S->lratBytes);
+  free (S->clid); free (S->conflictNo); free (S->ancAt); free (S->maxDep);
+  delete S->kept;
+  if (S->stream) { free (S->stream->B.index.table); free (S->stream->T.buffer); }
+  delete S->stream;
+  freeWriter (S->traceFile);
+  freeWriter (S->activeFile);
   return; }
 
 int onlyDelete (struct solver* S, int begin, int end) {
@@ -1851,7 +4135,7 @@ void printHelp ( ) {
   printf ("  -b          show progress bar\n");
   printf ("  -O          optimize proof till fixpoint by repeating verification.\n");
   printf ("              Max iterations must be given as a parameter\n");
-  printf ("  -C          compress core lemmas (emit binary proof)\n");
+  printf ("  -C          compress core lemmas (emit binary proof, for -l and -L)\n");
   printf ("  -D          delete proof file after parsing\n");
   printf ("  -w          suppress warning messages\n");
   printf ("  -W          exit after first warning\n");
@@ -1860,15 +4144,46 @@ void printHelp ( ) {
   printf ("  -R          turn off reduce mode\n\n");
   printf ("  -S          run in SAT check mode (forward checking)\n\n");
   printf ("  -m          Turn on binary mode\n\n");
+  printf ("  --pipeline  tokenize the input on a separate thread while building the clause database\n");
+  printf ("  --parse-threads N  parse a memory-mapped input formula with N threads\n");
+  printf ("  --check-threads N  check the lemmas in the backward pass (or with -f in windows of the\n");
+  printf ("              proof) with N threads, which share the clause database\n");
+  printf ("  --rat-threads N    propagate the candidates of large RAT checks in the backward pass\n");
+  printf ("              with N threads, which share the clause database (not with -f, -S, -i,\n");
+  printf ("              -o, --check-threads or --shards)\n");
+  printf ("  --shards N  check the lemmas in the backward pass with N forked processes, which\n");
+  printf ("              share the clause database copy-on-write\n");
+  printf ("  --spill-lrat DIR   keep the LRAT dependencies of -L in a temporary file in DIR\n");
+  printf ("              instead of in memory\n");
+  printf ("  --compact-lrat     keep the LRAT dependencies of -L delta and varint encoded\n");
+  printf ("  --shrink-db give the lemmas that the backward pass has passed back to the system,\n");
+  printf ("              keeping only the core lemmas for -l and -L (not with -O, -f,\n");
+  printf ("              --check-threads, --rat-threads or --shards)\n");
+  printf ("  --stream    check the proof in forward mode while it is read, e.g. from a pipe,\n");
+  printf ("              reusing the memory of deleted clauses (no -c, -l, -L, -r, -a or -O)\n\n");
   printf ("and input and proof are specified as follows\n\n");
   printf ("  INPUT       input file in DIMACS format\n");
   printf ("  PROOF       proof file in DRAT format (stdin if no argument)\n\n");
+  printf ("both files may be gzip, xz or zstd compressed\n\n");
   exit (0); }
 
 int main (int argc, char** argv) {
   struct solver S;
 
   S.cl_ids     = 0;
+  S.pipeline   = 0;
+  S.parseThreads = 1;
+  S.checkThreads = 0;
+  S.shards     = 0;
+  S.ratThreads = 0;
+  S.shrink     = 0;
+  S.kept       = NULL;
+  S.stream     = NULL;
+  S.result     = NULL;
+  S.view       = NULL;
+  S.scratch    = NULL;
+  S.helpers    = NULL;
+  S.markLog    = NULL;
   S.inputFile  = NULL;
   S.proofFile  = stdin;
   S.coreStr    = NULL;
@@ -1876,6 +4191,14 @@ int main (int argc, char** argv) {
   S.lemmaStr   = NULL;
   S.usedClFname  = NULL;
   S.lratFile   = NULL;
+  S.lratSpill  = NULL;
+  S.lratMap    = NULL;
+  S.lratMapSize = 0;
+  S.current     = NULL;
+  S.compactLRAT = 0;
+  S.lratBytes  = NULL;
+  S.lratBytesSize = S.lratBytesAlloc = S.lratInts = 0;
+  S.spillDir   = NULL;
   S.traceFile  = NULL;
   S.timeout    = TIMEOUT;
   S.nReads     = 0;
@@ -1901,17 +4224,32 @@ int main (int argc, char** argv) {
   S.decay = 0.8;
   S.start_time = cpuTime();
   S.anc_datas.resize(1); //the 0th is ignored
+  S.clid = S.conflictNo = S.ancAt = NULL;
+  S.maxDep = NULL;
+  S.metaAlloc = 0;
+  S.sweeps = 0;
 
   int i, tmp = 0;
   for (i = 1; i < argc; i++) {
-    if        (argv[i][0] == '-') {
+    if        (argv[i][0] == '-' && argv[i][1] == '-') {
+      if      (!strcmp (argv[i], "--pipeline")) S.pipeline = 1;
+      else if (!strcmp (argv[i], "--parse-threads") && i + 1 < argc) S.parseThreads = atoi (argv[++i]);
+      else if (!strcmp (argv[i], "--check-threads") && i + 1 < argc) S.checkThreads = atoi (argv[++i]);
+      else if (!strcmp (argv[i], "--shards") && i + 1 < argc) S.shards = atoi (argv[++i]);
+      else if (!strcmp (argv[i], "--spill-lrat") && i + 1 < argc) S.spillDir = argv[++i];
+      else if (!strcmp (argv[i], "--compact-lrat")) S.compactLRAT = 1;
+      else if (!strcmp (argv[i], "--shrink-db")) S.shrink = 1;
+      else if (!strcmp (argv[i], "--stream")) { if (!S.stream) S.stream = new stream (); }
+      else if (!strcmp (argv[i], "--rat-threads") && i + 1 < argc) S.ratThreads = atoi (argv[++i]);
+      else { printf ("c unknown option %s\n", argv[i]); printHelp (); } }
+    else if   (argv[i][0] == '-') {
       if      (argv[i][1] == 'h') printHelp ();
       else if (argv[i][1] == 'c') S.coreStr    = argv[++i];
-      else if (argv[i][1] == 'a') S.activeFile = fopen (argv[++i], "w");
+      else if (argv[i][1] == 'a') S.activeFile = openWriter (fopen (argv[++i], "w"));
       else if (argv[i][1] == 'l') S.lemmaStr   = argv[++i];
       else if (argv[i][1] == 'o') S.usedClFname= argv[++i];
-      else if (argv[i][1] == 'L') S.lratFile   = fopen (argv[++i], "w");
-      else if (argv[i][1] == 'r') S.traceFile  = fopen (argv[++i], "w");
+      else if (argv[i][1] == 'L') S.lratFile   = openWriter (fopen (argv[++i], "w"));
+      else if (argv[i][1] == 'r') S.traceFile  = openWriter (fopen (argv[++i], "w"));
       else if (argv[i][1] == 't') S.timeout    = atoi (argv[++i]);
       else if (argv[i][1] == 'd') S.decay      = atof (argv[++i]);
       else if (argv[i][1] == 'b') S.bar        = 1;
@@ -1937,29 +4275,44 @@ int main (int argc, char** argv) {
           printf ("c error opening \"%s\".\n", argv[i]); return ERROR; } }
 
       else if (tmp == 2) {
-        S.proofFile = fopen (argv[2], "r");
-        if (S.proofFile == NULL) {
-          printf ("c error opening \"%s\".\n", argv[i]); return ERROR; }
-
-        int j;
-        for (j = 0; j < 10; j++) {
-          int c = getc_unlocked (S.proofFile);
-          if (c == EOF) break;
-          if ((c != 100) && (c != 10) && (c != 13) && (c != 32) && (c != 45) && ((c < 48) || (c > 57)) && ((c < 65) || (c > 122)))  {
-            printf ("c turning on binary mode checking\n");
-            S.binMode = 1; break; } }
-        fclose (S.proofFile);
         S.proofFile = fopen (argv[2], "r");
         if (S.proofFile == NULL) {
           printf ("c error opening \"%s\".\n", argv[i]); return ERROR; } } } }
 
-  if (tmp == 1) printf ("c reading proof from stdin\n");
   if (tmp == 0) printHelp ();
+  if (S.stream) {
+    if (S.coreStr || S.lemmaStr || S.lratFile || S.traceFile || S.activeFile || S.usedClFname ||
+        S.cl_ids || S.optimize || S.mode == FORWARD_SAT || S.checkThreads || S.ratThreads || S.shards || S.shrink) {
+      printf ("c ERROR: --stream cannot be combined with -c, -l, -L, -r, -a, -o, -i, -O, -S, --check-threads,\n"
+              "c        --rat-threads, --shards or --shrink-db\n");
+      exit (0); }
+    S.mode = FORWARD_UNSAT; }
+  if (S.shrink && (S.optimize || S.mode == FORWARD_UNSAT || S.checkThreads || S.ratThreads || S.shards))
+    printf ("c WARNING: --shrink-db is ignored with -O, -f, --check-threads, --rat-threads or --shards\n");
+  if (S.ratThreads && (S.mode != BACKWARD_UNSAT || S.checkThreads || S.shards || S.cl_ids || S.usedClFname))
+    printf ("c WARNING: --rat-threads is ignored with -f, -S, -i, -o, --check-threads or --shards\n");
+#ifdef HAVE_MMAP
+  if (S.spillDir && !S.lratFile) printf ("c WARNING: --spill-lrat is ignored without -L\n");
+#else
+  if (S.spillDir) printf ("c WARNING: --spill-lrat is not supported on this platform; keeping the LRAT dependencies in memory\n");
+#endif
+  openReader (&S.formulaReader, S.inputFile);
+  openReader (&S.proofReader,   S.proofFile);
+  if (tmp == 2) { // sniff the first (decompressed) bytes of the proof for binary mode
+    struct reader *R = &S.proofReader;
+    int j;
+    peekChar (R);
+    for (j = 0; j < 10 && R->pos + j < R->end; j++) {
+      int c = R->pos[j];
+      if ((c != 100) && (c != 10) && (c != 13) && (c != 32) && (c != 45) && ((c < 48) || (c > 57)) && ((c < 65) || (c > 122)))  {
+        printf ("c turning on binary mode checking\n");
+        S.binMode = 1; break; } } }
+  if (tmp == 1) printf ("c reading proof from stdin\n");
   if (S.cl_ids) printf("Clause IDs expected.\n");
   int parseReturnValue = parse (&S);
 
   fclose (S.inputFile);
-  fclose (S.proofFile);
+  if (!S.stream) fclose (S.proofFile);
 
   if (S.mode == FORWARD_UNSAT) {
     S.reduce = 0; }
@@ -1973,8 +4326,10 @@ int main (int argc, char** argv) {
   else if  (parseReturnValue == UNSAT)          printf ("c trivial UNSAT\ns VERIFIED\n");
   else if  ((sts = verify_wrap_cl_used (&S, -1, -1, S.opt_iteration == S.optimize)) == UNSAT) printf ("s VERIFIED\n");
   else printf ("s NOT VERIFIED\n")  ;
+  if (S.stream) { closeReader (&S.proofReader); fclose (S.proofFile); }
   double runtime = cpuTime() - S.start_time;
   printf ("c verification time: %.3f seconds\n", runtime);
+  printf ("c watch lists peaked at %.2f MB\n", S.arenaPeak * sizeof (long) / 1048576.0);
 
   if (S.optimize) {
     double myTime = cpuTime();
@@ -36,6 +36,10 @@ static inline double cpuTimeTotal(void)
 {
     return (double)clock() / CLOCKS_PER_SEC;
 }
+static inline double wallTime(void)
+{
+    return (double)clock() / CLOCKS_PER_SEC;
+}
 
 #else //_MSC_VER
 #include <sys/time.h>
@@ -69,6 +73,13 @@ static inline double cpuTimeTotal(void)
     return (double)ru.ru_utime.tv_sec + (double)ru.ru_utime.tv_usec / 1000000.0;
 }
 
+static inline double wallTime(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
 #endif
 
 #endif //TIME_MEM_H